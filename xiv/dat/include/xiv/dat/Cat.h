@@ -6,6 +6,9 @@
 
 #include <boost/filesystem.hpp>
 
+#include <xiv/dat/Options.h>
+#include <xiv/dat/File.h>
+
 namespace xiv
 {
 namespace dat
@@ -13,7 +16,6 @@ namespace dat
 
 class Index;
 class Dat;
-class File;
 
 // A category represents an .index and its associated .datX
 class Cat
@@ -22,15 +24,26 @@ public:
     // i_base_path: Path to the folder containingthe datfiles
     // i_cat_nb: The number of the category
     // i_name: The name of the category, empty if not known
-    Cat(const boost::filesystem::path& i_base_path, uint32_t i_cat_nb, const std::string& i_name);
+    // i_options: How the .index/.datX files are read and decoded
+    Cat(const boost::filesystem::path& i_base_path, uint32_t i_cat_nb, const std::string& i_name, const Options& i_options = Options());
     ~Cat();
 
     // Returns .index of the category
     const Index& get_index() const;
 
+    // Returns the .datX with X == i_dat_nb
+    const Dat& get_dat(uint32_t i_dat_nb) const;
+
     // Retrieve a file from the category given its hashes
     std::unique_ptr<File> get_file(uint32_t dir_hash, uint32_t filename_hash) const;
 
+    // Retrieve a batch of files given their (dir_hash, filename_hash), see Dat::get_files
+    // All the hashes are resolved before any read, so a missing file throws before the callback is called
+    void get_files(const std::vector<std::pair<uint32_t, uint32_t>>& i_hashes, const FileCallback& i_callback) const;
+
+    // Stream a file from the category given its hashes, see Dat::stream_file
+    void stream_file(uint32_t dir_hash, uint32_t filename_hash, const BlockSink& i_sink) const;
+
 
     bool check_file_existence(uint32_t dir_hash, uint32_t filename_hash) const;
     bool check_dir_existence(uint32_t dir_hash) const;
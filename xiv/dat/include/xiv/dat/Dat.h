@@ -2,8 +2,11 @@
 #define XIV_DAT_DAT_H
 
 #include <xiv/dat/SqPack.h>
+#include <xiv/dat/Options.h>
+#include <xiv/dat/File.h>
 
-#include <mutex>
+#include <memory>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
@@ -12,31 +15,113 @@ namespace xiv
 namespace dat
 {
 
-class File;
-
 class Dat : public SqPack
 {
 public:
     // Full path to the dat file
-    Dat(const boost::filesystem::path& i_path, uint32_t i_nb);
+    Dat(const boost::filesystem::path& i_path, uint32_t i_nb, const Options& i_options = Options());
     virtual ~Dat();
 
+    // A block as it is stored in the dat
+    struct BlockView
+    {
+        // Compressed data, or directly the file data if the block is stored uncompressed
+        const char* data;
+        uint32_t size;
+        uint32_t uncompressed_size;
+        bool is_compressed;
+    };
+
+    // Where the parts of a file are in the dat, as described by its block infos
+    struct FileLayout
+    {
+        FileType type;
+        // Extent of the file in the dat, from its header to the end of its last part
+        uint32_t offset;
+        uint32_t end_offset;
+        // Texture header, stored as is before the blocks
+        uint32_t raw_header_offset;
+        uint32_t raw_header_size;
+        // Contiguous blocks of each block-encoded section and the end of the last one
+        std::vector<std::vector<uint32_t>> section_block_offsets;
+        std::vector<uint32_t> section_end_offsets;
+    };
+
     // Retrieves a file given the offset in the dat file
-    std::unique_ptr<File> get_file(uint32_t i_offset);
+    // Thread-safe: there is no lock, the raw blocks are gathered first then decompressed, concurrent calls run in parallel
+    std::unique_ptr<File> get_file(uint32_t i_offset) const;
+
+    // Retrieves a batch of files given their offsets in the dat file, i_callback gets the index of each file in i_offsets
+    // The files are read in dat order and nearby files are read together, so the callback is called in that order
+    void get_files(const std::vector<uint32_t>& i_offsets, const FileCallback& i_callback) const;
+    // Same but pipelined: this thread reads the runs of files in dat order while the workers of i_pool decode them
+    // i_callback is called from the workers, in any order, with the index of the file in i_offsets
+    // At most 2 runs per worker are in memory at once, it must not be called from a task of i_pool
+    void get_files(const std::vector<uint32_t>& i_offsets, const FileCallback& i_callback, utils::thread_pool::ThreadPool& i_pool) const;
+
+    // Streams a file given the offset in the dat file: i_sink gets its data one block at a time, in order
+    // Only one chunk of raw blocks (Options::stream_chunk_size) and one decompressed block are in memory at a time
+    // In positional mode the next chunk is read by a reader thread, one per stream, while the current one is decoded
+    void stream_file(uint32_t i_offset, const BlockSink& i_sink) const;
 
     // Appends to the vector the data of this block, it is assumed to be preallocated
-    // Is it also assumed that the _file_mutex is currently locked by this thread before the call
-    void extract_block(uint32_t i_offset, std::vector<char>& o_data);
+    // io_buffer is a scratch buffer, only used for positional reads
+    void extract_block(uint32_t i_offset, std::vector<char>& o_data, std::vector<char>& io_buffer) const;
+
+    // Returns a view on the block at i_offset
+    // Mapped: the view points straight into the mapping, uncompressed blocks can be used without any copy
+    // Positional: the block is read into io_buffer, which must outlive the view
+    BlockView get_block_view(uint32_t i_offset, std::vector<char>& io_buffer) const;
+
+    // Decodes a block into o_output, which must have room for its uncompressed_size
+    // Only touches memory, so it can run outside of any I/O
+    static void decode_block(const BlockView& i_block_view, char* o_output);
+
+    // Reads the header of the file at i_offset and computes where its blocks are, nothing is decoded
+    void get_file_layout(uint32_t i_offset, FileLayout& o_layout) const;
+
+    // Gathers the blocks of a section in one read: i_block_offsets are the contiguous blocks, i_end_offset the end of the last one
+    // The views point into io_buffer (positional) or into the mapping (mapped)
+    void gather_blocks(const std::vector<uint32_t>& i_block_offsets, uint32_t i_end_offset, std::vector<char>& io_buffer, std::vector<BlockView>& o_block_views) const;
 
     // Returns the dat number
     uint32_t get_nb() const;
 
 protected:
-    // File reading mutex to have only one thread reading the file at a time
-    std::mutex _file_mutex;
+    // Files of a batch read at once: the files [begin, end) of the batch in dat order, spanning size bytes at offset
+    struct Run
+    {
+        uint32_t begin;
+        uint32_t end;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // Sorts a batch in dat order, reads the layouts of its files and groups them in runs (see Options::coalesce_max_gap/size)
+    void plan_runs(const std::vector<uint32_t>& i_offsets, std::vector<uint32_t>& o_order, std::vector<FileLayout>& o_layouts, std::vector<Run>& o_runs) const;
+
+    // Builds the file from its raw bytes, i_data points to i_layout.offset and spans up to i_layout.end_offset
+    std::unique_ptr<File> decode_file(const FileLayout& i_layout, const char* i_data) const;
+
+    // Same as gather_blocks but from bytes already in memory, i_span_data points to the first block
+    static void parse_blocks(const std::vector<uint32_t>& i_block_offsets, uint32_t i_end_offset, const char* i_span_data, std::vector<BlockView>& o_block_views);
 
     // Dat nb
     uint32_t _nb;
+
+    // Pool used to decode the blocks of big files in parallel, can be null
+    utils::thread_pool::ThreadPool* _decode_pool;
+    uint32_t _parallel_decode_min_blocks;
+
+    // Limits for merging the reads of nearby files in get_files
+    uint32_t _coalesce_max_gap;
+    uint32_t _coalesce_max_size;
+
+    // Maximum size of the raw blocks read at once by stream_file
+    uint32_t _stream_chunk_size;
+
+    // Where the buffers of the files come from, new[] if null
+    FileAllocator* _file_allocator;
 };
 
 }
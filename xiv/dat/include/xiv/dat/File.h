@@ -1,7 +1,10 @@
 #ifndef XIV_DAT_FILE_H
 #define XIV_DAT_FILE_H
 
+#include <cstdint>
 #include <vector>
+#include <memory>
+#include <functional>
 
 #include <boost/filesystem.hpp>
 
@@ -20,7 +23,37 @@ namespace dat
 
 class Dat;
 
+// Provides the memory of the files, e.g. to recycle buffers or to draw them from an arena
+// It must outlive all the files allocated from it, and be thread-safe if files are read from several threads
+class FileAllocator
+{
+public:
+    virtual ~FileAllocator() {}
+
+    virtual char* allocate(std::size_t i_size) = 0;
+    virtual void deallocate(char* i_data, std::size_t i_size) = 0;
+};
+
+// View on a data section of a File, valid as long as the File
+class DataSection
+{
+public:
+    DataSection(const char* i_data, std::size_t i_size);
+
+    const char* data() const;
+    std::size_t size() const;
+    bool empty() const;
+
+    const char* begin() const;
+    const char* end() const;
+
+protected:
+    const char* _data;
+    std::size_t _size;
+};
+
 // Basic file from the dats
+// All the data sections are stored one after the other in a single buffer
 class File
 {
     friend class Dat;
@@ -31,16 +64,39 @@ public:
     FileType get_type() const;
 
     // Getters functions for the data in the file
-    const std::vector<std::vector<char>>& get_data_sections() const;
-    std::vector<std::vector<char>>& access_data_sections();
+    const std::vector<DataSection>& get_data_sections() const;
 
+    // The whole data: all the sections, one after the other
+    const char* get_data() const;
+    std::size_t get_size() const;
+
+    // Writes the whole data to i_path, throws if it could not be written entirely
     void export_as_bin(const boost::filesystem::path& i_path) const;
 
 protected:
+    // Allocates the buffer of the file, uninitialized, from i_allocator if not null
+    char* allocate(std::size_t i_size, FileAllocator* i_allocator);
+
     FileType _type;
-    std::vector<std::vector<char>> _data_sections;
+
+    FileAllocator* _allocator;
+    char* _data;
+    std::size_t _size;
+
+    std::vector<DataSection> _data_sections;
+
+private:
+    File(const File&);
+    File& operator=(const File&);
 };
 
+// Receives the files of a batch as they are read, i_index is the position of the file in the request
+typedef std::function<void(uint32_t i_index, std::unique_ptr<File> i_file)> FileCallback;
+
+// Receives the decompressed data of a streamed file block by block, in order, i_section is the index of its data section
+// i_data is only valid during the call
+typedef std::function<void(uint32_t i_section, const char* i_data, uint32_t i_size)> BlockSink;
+
 }
 }
 
@@ -2,18 +2,37 @@
 #define XIV_DAT_GAMEDATA_H
 
 #include <memory>
-#include <unordered_map>
+#include <atomic>
+#include <vector>
+#include <string>
 #include <mutex>
 
 #include <boost/filesystem.hpp>
 
+#include <xiv/dat/Options.h>
+#include <xiv/dat/File.h>
+#include <xiv/dat/PathHash.h>
+#include <xiv/dat/PathPattern.h>
+#include <xiv/dat/PathDictionary.h>
+
 namespace xiv
 {
 namespace dat
 {
 
 class Cat;
-class File;
+
+// Result of GameData::verify
+struct VerifyResult
+{
+    // Number of .index/.datX files and of hashed blocks in them
+    uint32_t file_count;
+    uint32_t block_count;
+    // Total size of the hashed blocks, in bytes
+    uint64_t size;
+    // The blocks that do not match their hash, as "path - offset: X - size: Y"
+    std::vector<std::string> invalid_blocks;
+};
 
 // Interface to all the datfiles - Main entry point
 // All the paths to files/dirs inside the dats are case-insensitive
@@ -21,7 +40,8 @@ class GameData
 {
 public:
     // This should be the path in which the .index/.datX files are located
-    GameData(const boost::filesystem::path& i_path);
+    // i_options: how the dats are read and decoded, e.g. ReadMode::mapped is the fastest when the same dats are read over and over
+    GameData(const boost::filesystem::path& i_path, const Options& i_options = Options());
     ~GameData();
 
     // Returns all the scanned category number available in the path
@@ -34,37 +54,97 @@ public:
 
     // Retrieve a file from the dats given its filename
     std::unique_ptr<File> get_file(const std::string& i_path);
+    // Same from the hashes of the path, e.g. to hash it once and look it up many times
+    std::unique_ptr<File> get_file(const PathHash& i_path_hash);
+
+    // Retrieve a batch of files given their filenames
+    // The files are grouped by category and dat then read in dat order, nearby files being read together
+    // i_callback is called as the files are read, with the index of the file in i_paths
+    void get_files(const std::vector<std::string>& i_paths, const FileCallback& i_callback);
+    void get_files(const std::vector<PathHash>& i_path_hashes, const FileCallback& i_callback);
+    // Same but returns the files in the order of i_paths
+    std::vector<std::unique_ptr<File>> get_files(const std::vector<std::string>& i_paths);
+
+    // Stream a file given its filename: i_sink gets the decompressed data one block at a time, the whole file is never in memory
+    void stream_file(const std::string& i_path, const BlockSink& i_sink);
+
+    // Writes the data sections of a file one after the other to i_output_path, same output as File::export_as_bin but streamed
+    void export_file_as_bin(const std::string& i_path, const boost::filesystem::path& i_output_path);
+
+    // Writes every file of a category to i_output_path as export_as_bin does, returns the total size written
+    // A file is named by its path from the path dictionary, by its hashes otherwise: unknown/<cat_name>/<dir_hash>/<filename_hash>
+    // Dictionary paths with a root or a . or .. component are named by their hashes too, so nothing is written outside i_output_path
+    // The files are read in (dat_nb, dat_offset) order, while the workers decode and write the previous ones (see Dat::get_files)
+    // Runs on i_pool if set, else on the decode_pool if set, on a temporary pool otherwise
+    // Throws if a file could not be written, the export then stops
+    uint64_t export_category(uint32_t i_cat_nb, const boost::filesystem::path& i_output_path, utils::thread_pool::ThreadPool* i_pool = nullptr);
+    // Same for all the categories, one after the other
+    uint64_t export_all(const boost::filesystem::path& i_output_path, utils::thread_pool::ThreadPool* i_pool = nullptr);
 
     // Checks that a file exists
     bool check_file_existence(const std::string& i_path);
+    bool check_file_existence(const PathHash& i_path_hash);
 
     // Checks that a dir exists, there must be a trailing / in the path
     // Note that it won't work for dirs that don't contain any file
     // e.g.:  - "ui/icon/" will return False
     //        - "ui/icon/000000/" will return True
     bool check_dir_existence(const std::string& i_path);
+    bool check_dir_existence(const PathHash& i_path_hash);
 
-protected:
-    // Return a specific category given a path (calls const Cat& get_category(const std::string& i_cat_name))
-    const Cat& get_category_from_path(const std::string& i_path);
+    // Sweeps all the patterns at the same time, i_callback gets the paths found as they are confirmed by the indexes
+    // Runs on i_pool if set, else on the decode_pool if set, on a temporary pool otherwise
+    void search_paths(const std::vector<PathPattern>& i_patterns, const PathCallback& i_callback, utils::thread_pool::ThreadPool* i_pool = nullptr);
 
-    // From a full path, returns the dir_hash and the filename_hash
-    void get_hashes(const std::string& i_path, uint32_t& o_dir_hash, uint32_t& o_filename_hash) const;
+    // Returns the path of a file from the path dictionary of the options, empty if it is unknown
+    // e.g. to name the entries of an index: find_path(PathHash(cat_nb, entry.dir_hash, entry.filename_hash))
+    std::string find_path(const PathHash& i_path_hash) const;
+    // Same for a dir, without the trailing /
+    std::string find_dir_path(uint32_t i_cat_nb, uint32_t i_dir_hash) const;
+    // The path dictionary, nullptr if there is none
+    const PathDictionary* get_path_dictionary() const;
 
-    // Lazy instantiation of category
-    void create_category(uint32_t i_cat_nb);
+    // Checks the SHA-1 of every hashed block of every .index/.datX, e.g. to validate an install after patching
+    // The blocks are checked in parallel, the largest first, the invalid ones are logged and returned
+    // Runs on i_pool if set, else on the decode_pool if set, on a temporary pool otherwise
+    VerifyResult verify(utils::thread_pool::ThreadPool* i_pool = nullptr);
+
+protected:
+    // Lazy instantiation of category, returns it whether it was created by this call or not
+    const Cat* create_category(uint32_t i_cat_nb);
 
     // Path given to constructor, pointing to the folder with the .index/.datX files
     const boost::filesystem::path _path;
 
+    // Options given to every category
+    const Options _options;
+
+    // A category and what is needed to create it once
+    struct CategorySlot
+    {
+        CategorySlot();
+
+        // Whether there is a .index for this category number, only written by the constructor
+        bool exists;
+        // Published once the category is fully created, so that a lookup is a single load
+        std::atomic<const Cat*> cat;
+        // Owns the category, only touched under creation_mutex
+        std::unique_ptr<Cat> owned_cat;
+        // Prevents two threads from instantiating the same category
+        std::mutex creation_mutex;
+    };
+
+    // Category numbers are 2 hex digits in the .index filenames
+    static const uint32_t cat_slot_count = 0x100;
+
     // Stored categories, indexed by their number, categories are instantiated and parsed individually when they are needed
-    std::unordered_map<uint32_t, std::unique_ptr<Cat>> _cats;
+    CategorySlot _cat_slots[cat_slot_count];
 
-    // List of all the categories numbers, is equal to _cats.keys()
+    // List of all the categories numbers, the ones with an existing slot
     std::vector<uint32_t> _cat_nbs;
 
-    // Mutexes needed to not instantiate the categories at the same time in two different threads, indexed by category number
-    std::unordered_map<uint32_t, std::unique_ptr<std::mutex>> _cat_creation_mutexes;
+    // Opened from Options::path_dictionary_path, if any
+    std::unique_ptr<PathDictionary> _path_dictionary;
 };
 
 }
@@ -2,8 +2,11 @@
 #define XIV_DAT_INDEX_H
 
 #include <xiv/dat/SqPack.h>
+#include <xiv/dat/Options.h>
 
-#include <unordered_map>
+#include <xiv/utils/crc32.h>
+
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
@@ -13,12 +16,13 @@ namespace dat
 {
 
 struct IndexBlockRecord;
+struct IndexCacheHeader;
 
 class Index : public SqPack
 {
 public:
     // Full path to the index file
-    Index(const boost::filesystem::path& i_path);
+    Index(const boost::filesystem::path& i_path, const Options& i_options = Options());
     virtual ~Index();
 
     // An entry in the hash table, representing a file in a given dat
@@ -30,9 +34,13 @@ public:
         uint32_t dat_offset;
     };
 
-    // HashTable has dir hashes -> filename hashes -> HashTableEntry
-    typedef std::unordered_map<uint32_t, HashTableEntry> DirHashTable;
-    typedef std::unordered_map<uint32_t, DirHashTable> HashTable;
+    // A dir of the index: its files are the entries [first_entry, first_entry + entry_count)
+    struct DirEntry
+    {
+        uint32_t dir_hash;
+        uint32_t first_entry;
+        uint32_t entry_count;
+    };
 
     // Get the number of dat files the index is linked to
     uint32_t get_dat_count() const;
@@ -40,19 +48,61 @@ public:
     bool check_file_existence(uint32_t dir_hash, uint32_t filename_hash) const;
     bool check_dir_existence(uint32_t dir_hash) const;
 
-    // Returns the whole HashTable
-    const HashTable& get_hash_table() const;
-    // Returns the hash table for a specific dir
-    const DirHashTable& get_dir_hash_table(uint32_t dir_hash) const;
-    // Returns the HashTableEntry for a given file given its hashes
+    // Returns all the entries, sorted by dir_hash then filename_hash, the files of a dir are contiguous
+    const std::vector<HashTableEntry>& get_entries() const;
+    // Returns all the dirs, sorted by dir_hash
+    const std::vector<DirEntry>& get_dirs() const;
+
+    // Returns the dir or nullptr if it is not in the index
+    const DirEntry* find_dir(uint32_t dir_hash) const;
+    // Returns the entry of a file in a dir found with find_dir, or nullptr
+    const HashTableEntry* find_entry(const DirEntry& i_dir_entry, uint32_t filename_hash) const;
+    // Returns the entry of a file given its hashes, or nullptr
+    const HashTableEntry* find_entry(uint32_t dir_hash, uint32_t filename_hash) const;
+
+    // Returns the dir, throws if it is not in the index
+    const DirEntry& get_dir_entry(uint32_t dir_hash) const;
+    // Returns the HashTableEntry for a given file given its hashes, throws if it is not in the index
     const HashTableEntry& get_hash_table_entry(uint32_t dir_hash, uint32_t filename_hash) const;
 
+    // Dirs whose path is i_format with the 4 digits at i_first_index (and i_second_index) set to the values of their range, 0000 to 9999 by default
+    // The candidates are probed as they are generated, see utils::crc32::search_hashes_1/2
+    std::vector<utils::crc32::HashHit> search_dirs(const std::string& i_format, uint32_t i_first_index,
+                                                   const utils::crc32::DigitRange& i_first_range = utils::crc32::full_digit_range) const;
+    std::vector<utils::crc32::HashHit> search_dirs(const std::string& i_format, uint32_t i_first_index, uint32_t i_second_index,
+                                                   utils::thread_pool::ThreadPool* i_pool = nullptr,
+                                                   const utils::crc32::DigitRange& i_first_range = utils::crc32::full_digit_range,
+                                                   const utils::crc32::DigitRange& i_second_range = utils::crc32::full_digit_range) const;
+    // Same for the filenames of a dir found with find_dir
+    std::vector<utils::crc32::HashHit> search_files(const DirEntry& i_dir_entry, const std::string& i_format, uint32_t i_first_index,
+                                                    const utils::crc32::DigitRange& i_first_range = utils::crc32::full_digit_range) const;
+
+    // Returns the bytes allocated for the lookup tables
+    std::size_t get_memory_usage() const;
+
 protected:
-    // Checks that the block is valid with regards to its hash
-    void is_index_block_valid(const IndexBlockRecord& i_index_block_record);
+    // Adds the block to the hashed blocks, see SqPack::get_hashed_blocks
+    void add_index_block(const IndexBlockRecord& i_index_block_record);
+
+    // Reads the hash table of the .index into _entries, in one go
+    void read_hash_table(const IndexBlockRecord& i_hash_table_block_record);
+
+    // Loads the tables from a cache file, returns false if it is missing or does not match i_cache_header
+    bool load_cache(const boost::filesystem::path& i_cache_path, const IndexCacheHeader& i_cache_header);
+    // Writes the tables to a cache file, failures are only logged
+    void save_cache(const boost::filesystem::path& i_cache_path, const IndexCacheHeader& i_cache_header) const;
+
+    // Builds _dirs and _dir_slots from the sorted _entries
+    void build_dir_table();
 
     uint32_t _dat_count;
-    HashTable _hash_table;
+
+    // Flat tables instead of per-file nodes: a lookup is one probe in _dir_slots then a binary search in the dir
+    std::vector<HashTableEntry> _entries;
+    std::vector<DirEntry> _dirs;
+    // Open addressing on dir_hash (a CRC, so its low bits are already well spread), linear probing
+    // Holds index in _dirs + 1, 0 for an empty slot, the size is a power of 2
+    std::vector<uint32_t> _dir_slots;
 };
 
 }
@@ -0,0 +1,70 @@
+#ifndef XIV_DAT_OPTIONS_H
+#define XIV_DAT_OPTIONS_H
+
+#include <cstdint>
+
+#include <boost/filesystem.hpp>
+
+#include <xiv/dat/SqPack.h>
+
+namespace xiv
+{
+namespace utils
+{
+namespace thread_pool
+{
+class ThreadPool;
+}
+}
+namespace dat
+{
+
+class FileAllocator;
+
+// Options used to open the dats, given to GameData and passed down to each category
+struct Options
+{
+    Options();
+
+    // How the .index/.datX files are read
+    ReadMode read_mode;
+
+    // Checks the SHA-1 of the hashed blocks of each .index/.datX when it is opened, the opening throws if one does not match
+    // The hashed block of a .datX covers all its data, so this reads the whole dat: GameData::verify is the faster way to check an install
+    bool verify_blocks;
+
+    // Opens and parses every .index in parallel in the GameData constructor, instead of on first use of each category
+    // Runs on the decode_pool if set, on a temporary pool otherwise
+    bool open_all_categories;
+
+    // If set, the blocks of big files are decompressed in parallel on this pool
+    // The pool is not owned and must outlive the GameData
+    utils::thread_pool::ThreadPool* decode_pool;
+    // Minimum number of blocks in a file for its decoding to be spread on the decode_pool
+    // Each block is at most 16KB uncompressed, under that the dispatch costs more than it saves
+    uint32_t parallel_decode_min_blocks;
+
+    // Batched reads (get_files): files at most coalesce_max_gap bytes apart are read together, up to coalesce_max_size bytes per read
+    uint32_t coalesce_max_gap;
+    uint32_t coalesce_max_size;
+
+    // Streamed reads (stream_file): maximum size of the raw blocks read at once
+    uint32_t stream_chunk_size;
+
+    // If set, the buffers of the files are allocated from it instead of new[]
+    // It is not owned and must outlive the files
+    FileAllocator* file_allocator;
+
+    // Folder where the lookup tables built from each .index are cached, empty to disable
+    // A cache is only used if the size, write time and hash table hash of its .index did not change
+    boost::filesystem::path index_cache_path;
+
+    // PathDictionary file giving the names behind the hashes of the indexes, see GameData::find_path, empty to disable
+    // A missing or invalid file is only logged, the lookups then find nothing
+    boost::filesystem::path path_dictionary_path;
+};
+
+}
+}
+
+#endif // XIV_DAT_OPTIONS_H
@@ -0,0 +1,99 @@
+#ifndef XIV_DAT_PATHDICTIONARY_H
+#define XIV_DAT_PATHDICTIONARY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <xiv/dat/PathHash.h>
+#include <xiv/dat/PathPattern.h>
+
+namespace xiv
+{
+namespace dat
+{
+
+class GameData;
+
+// Known paths of the dats by their hashes, the indexes only have the hashes so this is where the names come from
+// The file is mapped and searched in place: opening it does not depend on its size, a lookup is a binary search
+class PathDictionary
+{
+public:
+    // Maps a dictionary written by PathDictionaryBuilder, throws if it is not valid
+    explicit PathDictionary(const boost::filesystem::path& i_path);
+    ~PathDictionary();
+
+    uint32_t get_path_count() const;
+
+    // Returns the path of a file, empty if it is unknown
+    std::string find_path(const PathHash& i_path_hash) const;
+    // Returns the path of a dir without the trailing /, taken from any known file in it, empty if there is none
+    std::string find_dir_path(uint32_t i_cat_nb, uint32_t i_dir_hash) const;
+
+    // Calls i_callback with every path, sorted by category, dir_hash then filename_hash
+    void for_each_path(const PathCallback& i_callback) const;
+
+protected:
+    friend class PathDictionaryBuilder;
+
+    struct Entry;
+
+    // First entry not lower than the given hashes
+    const Entry* lower_bound(uint32_t i_cat_nb, uint32_t i_dir_hash, uint32_t i_filename_hash) const;
+    std::string get_path(const Entry& i_entry) const;
+
+    boost::interprocess::file_mapping _file_mapping;
+    boost::interprocess::mapped_region _mapped_region;
+
+    // Point into the mapping
+    const Entry* _entries;
+    uint32_t _entry_count;
+    const char* _strings;
+};
+
+// Collects paths and writes them as a PathDictionary
+// The adds can be called from any thread, e.g. straight from the callback of GameData::search_paths
+class PathDictionaryBuilder
+{
+public:
+    PathDictionaryBuilder();
+    ~PathDictionaryBuilder();
+
+    // Adds a path, lowercased, throws if it is not a valid path
+    void add(const std::string& i_path);
+    // Adds a path if it is a file of i_game_data and returns whether it was
+    // Any string can be given, e.g. all the strings of the exd sheets, the ones that are not paths are ignored
+    bool add_if_exists(GameData& i_game_data, const std::string& i_path);
+    // Adds all the paths of a dictionary, to extend it
+    void add(const PathDictionary& i_dictionary);
+
+    // Number of paths added so far, duplicates included
+    uint32_t get_path_count() const;
+
+    // Writes the paths, sorted and without duplicates, the file is replaced atomically, throws on failure
+    // On Windows a file cannot be replaced while it is mapped, so no PathDictionary must have it open
+    void write(const boost::filesystem::path& i_path) const;
+
+protected:
+    struct KnownPath
+    {
+        uint32_t cat_nb;
+        uint32_t dir_hash;
+        uint32_t filename_hash;
+        std::string path;
+    };
+
+    mutable std::mutex _paths_mutex;
+    std::vector<KnownPath> _paths;
+};
+
+}
+}
+
+#endif // XIV_DAT_PATHDICTIONARY_H
@@ -0,0 +1,160 @@
+#ifndef XIV_DAT_PATHHASH_H
+#define XIV_DAT_PATHHASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+
+namespace xiv
+{
+namespace dat
+{
+
+// Relation between category number and category name
+// These names are taken straight from the exe, it helps resolve dispatching when getting files by path
+struct CategoryName
+{
+    const char* name;
+    uint32_t nb;
+};
+
+constexpr CategoryName category_names[] = {
+    { "common",      0x00 },
+    { "bgcommon",    0x01 },
+    { "bg",          0x02 },
+    { "cut",         0x03 },
+    { "chara",       0x04 },
+    { "shader",      0x05 },
+    { "ui",          0x06 },
+    { "sound",       0x07 },
+    { "vfx",         0x08 },
+    { "ui_script",   0x09 },
+    { "exd",         0x0A },
+    { "game_script", 0x0B },
+    { "music",       0x0C }
+};
+constexpr uint32_t category_name_count = sizeof(category_names) / sizeof(CategoryName);
+
+// Compile-time helpers, written as single return statements to stay valid C++11 constexpr functions
+namespace path_hash
+{
+
+constexpr char to_lower(char i_char)
+{
+    return ((i_char >= 'A') && (i_char <= 'Z')) ? static_cast<char>(i_char - 'A' + 'a') : i_char;
+}
+
+// Bitwise crc32 step on the reflected polynomial, same as one lookup in the crc table
+constexpr uint32_t crc_bits(uint32_t i_crc, uint32_t i_bit_count)
+{
+    return (i_bit_count == 0) ? i_crc : crc_bits((i_crc & 1) ? (0xEDB88320 ^ (i_crc >> 1)) : (i_crc >> 1), i_bit_count - 1);
+}
+
+// crc32 of the lowercased [i_begin, i_end) of i_path, the final XOR 0xFFFFFFFF is not done like in the exe
+constexpr uint32_t crc_lower(const char* i_path, std::size_t i_begin, std::size_t i_end, uint32_t i_crc = 0xFFFFFFFF)
+{
+    return (i_begin == i_end) ? i_crc : crc_lower(i_path, i_begin + 1, i_end, crc_bits(i_crc ^ static_cast<uint8_t>(to_lower(i_path[i_begin])), 8));
+}
+
+// Position of the first / at or after i_pos, i_size if there is none
+constexpr std::size_t find_first_slash(const char* i_path, std::size_t i_size, std::size_t i_pos = 0)
+{
+    return (i_pos == i_size || i_path[i_pos] == '/') ? i_pos : find_first_slash(i_path, i_size, i_pos + 1);
+}
+
+// Position of the last / before i_pos, i_size if there is none
+constexpr std::size_t find_last_slash(const char* i_path, std::size_t i_size, std::size_t i_pos)
+{
+    return (i_pos == 0) ? i_size : ((i_path[i_pos - 1] == '/') ? i_pos - 1 : find_last_slash(i_path, i_size, i_pos - 1));
+}
+
+// Whether the lowercased [0, i_size) of i_path is exactly i_name
+constexpr bool equals_lower(const char* i_path, std::size_t i_size, const char* i_name, std::size_t i_pos = 0)
+{
+    return (i_pos == i_size) ? (i_name[i_pos] == '\0') : ((to_lower(i_path[i_pos]) == i_name[i_pos]) && equals_lower(i_path, i_size, i_name, i_pos + 1));
+}
+
+// Category number from the name in [0, i_size) of i_path
+constexpr uint32_t find_category_nb(const char* i_path, std::size_t i_size, uint32_t i_index = 0)
+{
+    return (i_index == category_name_count) ? throw std::runtime_error("Category not found in path") :
+           (equals_lower(i_path, i_size, category_names[i_index].name) ? category_names[i_index].nb : find_category_nb(i_path, i_size, i_index + 1));
+}
+
+// Length of the string in a char array: up to the first null, at most i_max_size
+// An array bigger than its content (char buffer[64] = "...") must not hash its trailing nulls
+constexpr std::size_t get_length(const char* i_path, std::size_t i_max_size, std::size_t i_pos = 0)
+{
+    return (i_pos == i_max_size || i_path[i_pos] == '\0') ? i_pos : get_length(i_path, i_max_size, i_pos + 1);
+}
+
+constexpr std::size_t check_slash(std::size_t i_slash_pos, std::size_t i_size)
+{
+    return (i_slash_pos == i_size) ? throw std::runtime_error("Path do not have a / char") : i_slash_pos;
+}
+
+}
+
+// Hashes of a path inside the dats: category number, dir hash and filename hash
+// Hashing once then looking up many times saves the string handling of the path based lookups
+// From a literal it can be computed at compile time: constexpr PathHash root_exl("exd/root.exl");
+class PathHash
+{
+public:
+    // Compile time (or runtime, but slowly) from a literal
+    // Any char array binds here too, so the path stops at its first null rather than at N - 1
+    template <std::size_t N>
+    constexpr explicit PathHash(const char (&i_path)[N]) :
+        PathHash(i_path, path_hash::get_length(i_path, N - 1), LiteralTag())
+    {
+    }
+
+    // Runtime, the path is lowercased then hashed with utils::crc32, no allocation below path_stack_size chars
+    // Throws if the path has no / or its category is unknown
+    PathHash(const char* i_path, std::size_t i_size);
+    explicit PathHash(const std::string& i_path);
+
+    // Same without throwing, for the strings that may not be paths: returns false and leaves o_path_hash as is if it is not one
+    static bool try_parse(const char* i_path, std::size_t i_size, PathHash& o_path_hash);
+    static bool try_parse(const std::string& i_path, PathHash& o_path_hash);
+
+    constexpr PathHash(uint32_t i_cat_nb, uint32_t i_dir_hash, uint32_t i_filename_hash) :
+        _cat_nb(i_cat_nb),
+        _dir_hash(i_dir_hash),
+        _filename_hash(i_filename_hash)
+    {
+    }
+
+    constexpr uint32_t get_cat_nb() const { return _cat_nb; }
+    constexpr uint32_t get_dir_hash() const { return _dir_hash; }
+    constexpr uint32_t get_filename_hash() const { return _filename_hash; }
+
+    static const std::size_t path_stack_size = 0x200;
+
+protected:
+    // Only tells the compile time constructor apart, an int would make PathHash(0, 0, 0) pick it
+    struct LiteralTag {};
+
+    // Compile time hashing of the i_size first chars of i_path
+    constexpr PathHash(const char* i_path, std::size_t i_size, LiteralTag) :
+        _cat_nb(path_hash::find_category_nb(i_path, path_hash::check_slash(path_hash::find_first_slash(i_path, i_size), i_size))),
+        _dir_hash(path_hash::crc_lower(i_path, 0, path_hash::find_last_slash(i_path, i_size, i_size))),
+        _filename_hash(path_hash::crc_lower(i_path, path_hash::find_last_slash(i_path, i_size, i_size) + 1, i_size))
+    {
+    }
+
+    uint32_t _cat_nb;
+    uint32_t _dir_hash;
+    uint32_t _filename_hash;
+};
+
+// Returns the number of a category from its name, throws if it is unknown
+uint32_t get_category_nb(const std::string& i_cat_name);
+// Returns the name of a category from its number, empty if it is unknown
+std::string get_category_name(uint32_t i_cat_nb);
+
+}
+}
+
+#endif // XIV_DAT_PATHHASH_H
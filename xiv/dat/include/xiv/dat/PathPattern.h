@@ -0,0 +1,95 @@
+#ifndef XIV_DAT_PATHPATTERN_H
+#define XIV_DAT_PATHPATTERN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace xiv
+{
+namespace utils
+{
+namespace thread_pool
+{
+class ThreadPool;
+}
+namespace crc32
+{
+struct DigitRange;
+}
+}
+namespace dat
+{
+
+class Index;
+
+// Receives the paths found by a search, called concurrently from the threads of the pool
+typedef std::function<void(const std::string& i_path)> PathCallback;
+
+// A family of paths to look for in the dats, e.g.: "chara/monster/m{0000-9999}/obj/body/b{0000-9999}/model/m{1}b{2}.mdl"
+// {xxxx-yyyy}: a group of 4 digits taking every value of the range, the groups are numbered from 1 in order of appearance
+// {n}: the value of the group n, only in the filename
+// {a|b|c}: alternatives, only in the filename, each dir found is searched for all of them
+// The dir can hold up to 2 groups and the filename 1, the dirs are swept first then the filenames in each dir found
+class PathPattern
+{
+public:
+    // Parses and compiles the pattern, throws if it is not valid
+    explicit PathPattern(const std::string& i_pattern);
+
+    const std::string& get_pattern() const;
+    uint32_t get_cat_nb() const;
+
+    // Calls i_callback with every path of the pattern in i_index, which must be the index of the category of the pattern
+    // The dirs with 2 groups and the files of the dirs found are spread on i_pool
+    void search(const Index& i_index, const PathCallback& i_callback, utils::thread_pool::ThreadPool& i_pool) const;
+
+protected:
+    // A group of 4 digits, position is in the dir or the filename format
+    struct DigitGroup
+    {
+        uint32_t position;
+        uint32_t min_value;
+        uint32_t max_value;
+    };
+
+    // A {n} in the filename
+    struct GroupReference
+    {
+        uint32_t position;
+        uint32_t group;
+    };
+
+    // A filename once the alternatives are expanded: lowercased, its references to the dir groups and its own group if any
+    struct Filename
+    {
+        std::string format;
+        std::vector<GroupReference> references;
+        std::vector<DigitGroup> groups;
+    };
+
+    // Parses i_text into o_format, groups are written as 0000, references are only allowed if o_references is set
+    void parse(const std::string& i_text, std::string& o_format, std::vector<DigitGroup>& o_groups, std::vector<GroupReference>* o_references) const;
+    // All the combinations of the {a|b|c} of i_text
+    std::vector<std::string> expand_alternatives(const std::string& i_text) const;
+
+    // Writes the 4 digits of i_value at i_position
+    static void write_digits(std::string& io_format, uint32_t i_position, uint32_t i_value);
+    // The values of a group, for the searches to only hash those
+    static utils::crc32::DigitRange get_range(const DigitGroup& i_group);
+
+    std::string _pattern;
+    uint32_t _cat_nb;
+
+    // Lowercased dir without the trailing /, and its groups
+    std::string _dir_format;
+    std::vector<DigitGroup> _dir_groups;
+
+    std::vector<Filename> _filenames;
+};
+
+}
+}
+
+#endif // XIV_DAT_PATHPATTERN_H
@@ -1,11 +1,16 @@
 #ifndef XIV_DAT_SQPACK_H
 #define XIV_DAT_SQPACK_H
 
-#include <fstream>
+#include <vector>
 
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include <xiv/utils/bparse.h>
+#include <xiv/utils/sha1.h>
+
+#include <xiv/dat/logger.h>
 
 // Common struct containing the SHA-1 hash
 // Used for data integrity in all Sqpack files
@@ -13,6 +18,13 @@ XIV_STRUCT((xiv)(dat), SqPackBlockHash,
            XIV_MEM_ARR(uint8_t, hash, 0x14)
            XIV_MEM_ARR(uint32_t, padding, 0xB));
 
+// How the SqPack files are accessed
+// positional => pread/ReadFile at offset on a shared handle
+// mapped => the whole file is mapped in memory, reads are served from the page cache without syscalls
+XIV_ENUM((xiv)(dat), ReadMode, uint32_t,
+         XIV_VALUE(positional, 0)
+         XIV_VALUE(mapped,     1));
+
 namespace xiv
 {
 namespace dat
@@ -22,15 +34,79 @@ class SqPack
 {
 public:
     // Full path to the sqpack file
-    SqPack(const boost::filesystem::path& i_path);
+    SqPack(const boost::filesystem::path& i_path, ReadMode i_read_mode = ReadMode::positional);
     virtual ~SqPack();
 
+    ReadMode get_read_mode() const;
+    const boost::filesystem::path& get_path() const;
+
+    // A range of the file and the SHA-1 the headers give for it
+    struct HashedBlock
+    {
+        uint32_t offset;
+        uint32_t size;
+        utils::sha1::Digest hash;
+    };
+
+    // The ranges with a hash: the SqPack header, the Index/Dat header and the blocks it declares
+    // The ones whose hash is all zeros are not hashed by the game and are left out
+    const std::vector<HashedBlock>& get_hashed_blocks() const;
+
+    // Hashes the range and compares it with its hash, i_chunk_size bytes are read at a time
+    // A SHA-1 is sequential, to check many blocks quickly check them in parallel (see GameData::verify)
+    bool is_block_valid(const HashedBlock& i_hashed_block, uint32_t i_chunk_size = 4 * 1024 * 1024) const;
+
+    // Checks all the hashed blocks, throws on the first invalid one
+    void check_hashed_blocks() const;
+
 protected:
-    // Checks that a given block is valid iven its hash
-    void is_block_valid(uint32_t i_offset, uint32_t i_size, const SqPackBlockHash& i_block_hash);
+    // Closes the native file handle if it is open (positional only)
+    void close_handle();
+
+    // Adds a block to the hashed blocks, nothing is read until it is checked
+    void add_hashed_block(uint32_t i_offset, uint32_t i_size, const SqPackBlockHash& i_block_hash);
+
+    // Reads i_size bytes at i_offset in the file into o_data
+    // Reads are positional (pread/ReadFile at offset), there is no shared cursor so any number of threads can read at the same time
+    void read(uint32_t i_offset, uint32_t i_size, char* o_data) const;
+
+    // Returns a pointer to i_size bytes at i_offset in the file
+    // Mapped: points straight into the mapping, no copy is done
+    // Positional: the bytes are read into io_buffer, which must outlive the use of the pointer
+    const char* get_data(uint32_t i_offset, uint32_t i_size, std::vector<char>& io_buffer) const;
+
+    // Bounds checked pointer into the mapping
+    const char* get_mapped_data(uint32_t i_offset, uint32_t i_size) const;
+
+    // Extracts a struct at a given offset in the file, same as utils::bparse::extract but through read()
+    template <typename StructType>
+    StructType extract_at(uint32_t i_offset, xiv::utils::log::Severity i_severity = xiv::utils::log::Severity::debug) const
+    {
+        StructType temp_struct;
+        read(i_offset, sizeof(StructType), reinterpret_cast<char*>(&temp_struct));
+        utils::bparse::reorder(temp_struct);
+        XIV_DEBUG_LOG(xiv_dat_logger, i_severity, "Extracted: " << temp_struct);
+        return temp_struct;
+    }
+
+    // Offset right after the SqPack headers, where the Index/Dat specific header starts
+    uint32_t _sub_header_offset;
+
+    const boost::filesystem::path _path;
+    ReadMode _read_mode;
+
+    std::vector<HashedBlock> _hashed_blocks;
+
+    // Native file handle, shared by all the readers (positional only)
+#ifdef _WIN32
+    void* _handle;
+#else
+    int _handle;
+#endif
 
-    // File handle
-    std::ifstream _handle;
+    // Mapping of the whole file (mapped only)
+    boost::interprocess::file_mapping _file_mapping;
+    boost::interprocess::mapped_region _mapped_region;
 };
 
 }
@@ -10,11 +10,11 @@ namespace xiv
 namespace dat
 {
 
-Cat::Cat(const boost::filesystem::path& i_base_path, uint32_t i_cat_nb, const std::string& i_name) :
+Cat::Cat(const boost::filesystem::path& i_base_path, uint32_t i_cat_nb, const std::string& i_name, const Options& i_options) :
     _name(i_name),
     _nb(i_cat_nb)
 {
-    XIV_INFO(xiv_dat_logger, "Initializing Cat with path: " << i_base_path << " - nb: " << i_cat_nb << " - name: " << i_name);
+    XIV_INFO(xiv_dat_logger, "Initializing Cat with path: " << i_base_path << " - nb: " << i_cat_nb << " - name: " << i_name << " - read_mode: " << i_options.read_mode);
 
     // From the category number, compute back the real filename for.index .datXs
     std::stringstream ss;
@@ -22,12 +22,12 @@ Cat::Cat(const boost::filesystem::path& i_base_path, uint32_t i_cat_nb, const st
     std::string prefix = ss.str() + "0000.win32";
 
     // Creates the index: XX0000.win32.index
-    _index = std::unique_ptr<Index>(new Index(i_base_path / (prefix + ".index")));
+    _index = std::unique_ptr<Index>(new Index(i_base_path / (prefix + ".index"), i_options));
 
     // For all dat files linked to this index, create it: XX0000.win32.datX
     for (uint32_t i = 0; i < get_index().get_dat_count(); ++i)
     {
-        _dats.emplace_back(std::unique_ptr<Dat>(new Dat(i_base_path / (prefix + ".dat" + std::to_string(i)), i)));
+        _dats.emplace_back(std::unique_ptr<Dat>(new Dat(i_base_path / (prefix + ".dat" + std::to_string(i)), i, i_options)));
     }
 }
 
@@ -41,6 +41,11 @@ const Index& Cat::get_index() const
     return *_index;
 }
 
+const Dat& Cat::get_dat(uint32_t i_dat_nb) const
+{
+    return *_dats.at(i_dat_nb);
+}
+
 std::unique_ptr<File> Cat::get_file(uint32_t dir_hash, uint32_t filename_hash) const
 {
     XIV_DEBUG(xiv_dat_logger, "Get file cat: " << _name << " - nb: " << _nb << " - dir_hash: " << dir_hash << " - filename_hash : " << filename_hash);
@@ -50,6 +55,36 @@ std::unique_ptr<File> Cat::get_file(uint32_t dir_hash, uint32_t filename_hash) c
     return _dats[hash_table_entry.dat_nb]->get_file(hash_table_entry.dat_offset);
 }
 
+void Cat::get_files(const std::vector<std::pair<uint32_t, uint32_t>>& i_hashes, const FileCallback& i_callback) const
+{
+    // Split the batch by dat, keeping track of where each file was in the request
+    std::vector<std::vector<uint32_t>> dat_offsets(_dats.size());
+    std::vector<std::vector<uint32_t>> dat_indices(_dats.size());
+    for (uint32_t i = 0; i < i_hashes.size(); ++i)
+    {
+        auto& hash_table_entry = get_index().get_hash_table_entry(i_hashes[i].first, i_hashes[i].second);
+        dat_offsets.at(hash_table_entry.dat_nb).push_back(hash_table_entry.dat_offset);
+        dat_indices.at(hash_table_entry.dat_nb).push_back(i);
+    }
+
+    for (uint32_t i = 0; i < _dats.size(); ++i)
+    {
+        if (!dat_offsets[i].empty())
+        {
+            auto& indices = dat_indices[i];
+            _dats[i]->get_files(dat_offsets[i], [&indices, &i_callback](uint32_t i_index, std::unique_ptr<File> i_file) {
+                i_callback(indices[i_index], std::move(i_file));
+            });
+        }
+    }
+}
+
+void Cat::stream_file(uint32_t dir_hash, uint32_t filename_hash, const BlockSink& i_sink) const
+{
+    auto& hash_table_entry = get_index().get_hash_table_entry(dir_hash, filename_hash);
+    _dats.at(hash_table_entry.dat_nb)->stream_file(hash_table_entry.dat_offset, i_sink);
+}
+
 bool Cat::check_file_existence(uint32_t dir_hash, uint32_t filename_hash) const
 {
     return get_index().check_file_existence(dir_hash, filename_hash);
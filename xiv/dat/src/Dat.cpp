@@ -1,6 +1,16 @@
 #include <xiv/dat/Dat.h>
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
 #include <xiv/utils/zlib.h>
+#include <xiv/utils/stream.h>
+#include <xiv/utils/thread_pool.h>
+#include <xiv/utils/work_queue.h>
 
 #include <xiv/dat/logger.h>
 #include <xiv/dat/File.h>
@@ -55,172 +65,626 @@ XIV_STRUCT((xiv)(dat), DatTexFileBlockInfos,
 
 using xiv::utils::bparse::extract;
 
+namespace
+{
+// Fills the sizes of a view from the header of the block, data is left to the caller
+xiv::dat::Dat::BlockView make_block_view(const xiv::dat::DatBlockHeader& i_block_header)
+{
+    xiv::dat::Dat::BlockView block_view;
+    block_view.data = nullptr;
+    // 32000 in compressed_size means it is not compressed so take uncompressed_size
+    block_view.is_compressed = (i_block_header.compressed_size != 32000);
+    block_view.size = block_view.is_compressed ? i_block_header.compressed_size : i_block_header.uncompressed_size;
+    block_view.uncompressed_size = i_block_header.uncompressed_size;
+    return block_view;
+}
+}
+
 namespace xiv
 {
 namespace dat
 {
 
-Dat::Dat(const boost::filesystem::path& i_path, uint32_t i_nb) :
-    SqPack(i_path),
-    _nb(i_nb)
+Dat::Dat(const boost::filesystem::path& i_path, uint32_t i_nb, const Options& i_options) :
+    SqPack(i_path, i_options.read_mode),
+    _nb(i_nb),
+    _decode_pool(i_options.decode_pool),
+    _parallel_decode_min_blocks(i_options.parallel_decode_min_blocks),
+    _coalesce_max_gap(i_options.coalesce_max_gap),
+    _coalesce_max_size(i_options.coalesce_max_size),
+    _stream_chunk_size(i_options.stream_chunk_size),
+    _file_allocator(i_options.file_allocator)
 {
-    auto block_record = extract<xiv_dat_logger, DatBlockRecord>(_handle);
+    auto block_record = extract_at<DatBlockRecord>(_sub_header_offset);
     block_record.offset *= 0x80;
-    is_block_valid(block_record.offset, block_record.size, block_record.block_hash);
+    add_hashed_block(block_record.offset, block_record.size, block_record.block_hash);
+
+    if (i_options.verify_blocks)
+    {
+        check_hashed_blocks();
+    }
 }
 
 Dat::~Dat()
 {
 }
 
-std::unique_ptr<File> Dat::get_file(uint32_t i_offset)
+std::unique_ptr<File> Dat::get_file(uint32_t i_offset) const
 {
     XIV_DEBUG(xiv_dat_logger, "Get file nb: " << _nb << " - offset: " << i_offset);
 
-    std::unique_ptr<File> output_file(new File());
-    {
-        // Lock in this scope
-        std::lock_guard<std::mutex> lock(_file_mutex);
+    // The decoding is done in two phases:
+    // - gather: from the block infos, compute where the parts of the file are and fetch their raw bytes in one read
+    // - decode: decompress every gathered block into its section, this is pure CPU work on memory
+    FileLayout layout;
+    get_file_layout(i_offset, layout);
+
+    std::vector<char> buffer;
+    auto data = get_data(layout.offset, layout.end_offset - layout.offset, buffer);
+    return decode_file(layout, data);
+}
 
-        // Seek to the start of the header of the file record and extract it
-        _handle.seekg(i_offset);
-        auto file_header = extract<xiv_dat_logger, DatFileHeader>(_handle);
+void Dat::plan_runs(const std::vector<uint32_t>& i_offsets, std::vector<uint32_t>& o_order, std::vector<FileLayout>& o_layouts, std::vector<Run>& o_runs) const
+{
+    // Visit the files in dat order so that the reads only go forward
+    o_order.resize(i_offsets.size());
+    for (uint32_t i = 0; i < o_order.size(); ++i)
+    {
+        o_order[i] = i;
+    }
+    std::stable_sort(o_order.begin(), o_order.end(),
+                     [&i_offsets](uint32_t i_lhs, uint32_t i_rhs) {
+                         return i_offsets[i_lhs] < i_offsets[i_rhs];
+                     });
+
+    // Layouts first: only the headers are read, it gives the extent of every file
+    o_layouts.resize(i_offsets.size());
+    for (auto index: o_order)
+    {
+        get_file_layout(i_offsets[index], o_layouts[index]);
+    }
 
-        switch(file_header.entry_type)
+    // Then one read per run of files close enough to each other
+    o_runs.clear();
+    uint32_t run_begin = 0;
+    while (run_begin < o_order.size())
+    {
+        Run run;
+        run.begin = run_begin;
+        run.offset = o_layouts[o_order[run_begin]].offset;
+        uint32_t run_end = o_layouts[o_order[run_begin]].end_offset;
+        run.end = run_begin + 1;
+        for (; run.end < o_order.size(); ++run.end)
         {
-        case FileType::empty:
-            XIV_WARNING(xiv_dat_logger, "File is empty");
-            break;
+            auto& layout = o_layouts[o_order[run.end]];
+            const uint32_t new_run_end = std::max(run_end, layout.end_offset);
+            // Reading the gap is cheaper than seeking over it, up to a point
+            if ((uint64_t(layout.offset) > uint64_t(run_end) + _coalesce_max_gap) || (new_run_end - run.offset > _coalesce_max_size))
+            {
+                break;
+            }
+            run_end = new_run_end;
+        }
+        run.size = run_end - run.offset;
+        o_runs.push_back(run);
+
+        run_begin = run.end;
+    }
+}
+
+void Dat::get_files(const std::vector<uint32_t>& i_offsets, const FileCallback& i_callback) const
+{
+    XIV_DEBUG(xiv_dat_logger, "Get files nb: " << _nb << " - count: " << i_offsets.size());
 
-        case FileType::standard:
+    std::vector<uint32_t> order;
+    std::vector<FileLayout> layouts;
+    std::vector<Run> runs;
+    plan_runs(i_offsets, order, layouts, runs);
+
+    // Each run is decoded as soon as it is in memory
+    std::vector<char> buffer;
+    for (auto& run: runs)
+    {
+        XIV_TRACE(xiv_dat_logger, "Read run - offset: " << run.offset << " - size: " << run.size << " - files: " << run.end - run.begin);
+        auto run_data = get_data(run.offset, run.size, buffer);
+        for (uint32_t i = run.begin; i < run.end; ++i)
         {
-            output_file->_type = FileType::standard;
+            auto& layout = layouts[order[i]];
+            i_callback(order[i], decode_file(layout, run_data + (layout.offset - run.offset)));
+        }
+    }
+}
 
-            uint32_t number_of_blocks = extract<xiv_dat_logger, uint32_t>(_handle, "number_of_blocks");
+void Dat::get_files(const std::vector<uint32_t>& i_offsets, const FileCallback& i_callback, utils::thread_pool::ThreadPool& i_pool) const
+{
+    XIV_DEBUG(xiv_dat_logger, "Get files nb: " << _nb << " - count: " << i_offsets.size() << " - pipelined");
 
-            // Just extract offset infos for the blocks to extract
-            std::vector<DatStdFileBlockInfos> std_file_block_infos;
-            extract<xiv_dat_logger, DatStdFileBlockInfos>(_handle, number_of_blocks, std_file_block_infos);
+    std::vector<uint32_t> order;
+    std::vector<FileLayout> layouts;
+    std::vector<Run> runs;
+    plan_runs(i_offsets, order, layouts, runs);
 
-            // Pre allocate data vector for the whole file
-            output_file->_data_sections.resize(1);
-            auto& data_section = output_file->_data_sections.front();
+    // The runs handed to the workers and not done yet, bounded so that the reads do not get too far ahead of the decoding
+    const uint32_t max_pending_run_count = 2 * i_pool.get_thread_count();
+    uint32_t pending_run_count = 0;
+    std::exception_ptr exception;
+    std::mutex pending_mutex;
+    std::condition_variable pending_cv;
 
-            data_section.reserve(file_header.total_uncompressed_size);
-            // Extract each block
-            for (auto& file_block_info: std_file_block_infos)
+    for (auto& run: runs)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pending_mutex);
+            pending_cv.wait(lock, [&] { return pending_run_count < max_pending_run_count; });
+            if (exception)
             {
-                extract_block(i_offset + file_header.size + file_block_info.offset, data_section);
+                break;
             }
+            ++pending_run_count;
         }
-        break;
 
-        case FileType::model:
+        // Read on this thread, the buffer then belongs to the task
+        XIV_TRACE(xiv_dat_logger, "Read run - offset: " << run.offset << " - size: " << run.size << " - files: " << run.end - run.begin);
+        std::shared_ptr<std::vector<char>> buffer = std::make_shared<std::vector<char>>();
+        const char* run_data = nullptr;
+        try
         {
-            output_file->_type = FileType::model;
-
-            DatMdlFileBlockInfos mdl_file_block_infos = extract<xiv_dat_logger, DatMdlFileBlockInfos>(_handle);
-
-            // Getting the block number and read their sizes
-            const uint32_t block_count = mdl_file_block_infos.block_ids[::model_section_count - 1] + mdl_file_block_infos.block_counts[::model_section_count - 1];
-            std::vector<uint16_t> block_sizes;
-            extract<xiv_dat_logger, uint16_t>(_handle, "block_size", block_count, block_sizes);
-
-            // Preallocate sufficient space
-            output_file->_data_sections.resize(::model_section_count);
+            run_data = get_data(run.offset, run.size, *buffer);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex);
+            exception = std::current_exception();
+            --pending_run_count;
+            break;
+        }
 
-            for (uint32_t i = 0; i < ::model_section_count; ++i)
+        i_pool.push([&, buffer, run_data, run] {
+            try
             {
-                // Preallocating for section
-                auto& data_section = output_file->_data_sections[i];
-                data_section.reserve(mdl_file_block_infos.uncompressed_sizes[i]);
-
-                uint32_t current_offset = i_offset + file_header.size + mdl_file_block_infos.offsets[i];
-                for (uint32_t j = 0; j < mdl_file_block_infos.block_counts[i]; ++j)
+                for (uint32_t i = run.begin; i < run.end; ++i)
                 {
-                    extract_block(current_offset, data_section);
-                    current_offset += block_sizes[mdl_file_block_infos.block_ids[i] + j];
+                    auto& layout = layouts[order[i]];
+                    i_callback(order[i], decode_file(layout, run_data + (layout.offset - run.offset)));
                 }
             }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex);
+                if (!exception)
+                {
+                    exception = std::current_exception();
+                }
+            }
+
+            // Notified under the lock, the caller may return and destroy the condition variable as soon as it sees the count
+            std::lock_guard<std::mutex> lock(pending_mutex);
+            --pending_run_count;
+            pending_cv.notify_all();
+        });
+    }
+
+    // The tasks use the locals of this call, so all of them must be done before returning
+    std::unique_lock<std::mutex> lock(pending_mutex);
+    pending_cv.wait(lock, [&] { return pending_run_count == 0; });
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+std::unique_ptr<File> Dat::decode_file(const FileLayout& i_layout, const char* i_data) const
+{
+    std::unique_ptr<File> output_file(new File());
+    output_file->_type = i_layout.type;
+
+    auto& section_block_offsets = i_layout.section_block_offsets;
+    auto& section_end_offsets = i_layout.section_end_offsets;
+
+    // Gather phase: the views point into the raw bytes of the file
+    const uint32_t section_count = section_block_offsets.size();
+    std::vector<std::vector<BlockView>> section_block_views(section_count);
+    for (uint32_t i = 0; i < section_count; ++i)
+    {
+        if (!section_block_offsets[i].empty())
+        {
+            parse_blocks(section_block_offsets[i], section_end_offsets[i], i_data + (section_block_offsets[i].front() - i_layout.offset), section_block_views[i]);
         }
-        break;
+    }
 
-        case FileType::texture:
+    // Decode phase: size every section from the uncompressed sizes of its blocks, then allocate the whole file at once
+    // The texture header is not block-encoded, it goes as is in section 0
+    const bool has_raw_header = (i_layout.type == FileType::texture);
+    std::vector<uint32_t> section_sizes;
+    if (has_raw_header)
+    {
+        section_sizes.push_back(i_layout.raw_header_size);
+    }
+    std::size_t file_size = has_raw_header ? i_layout.raw_header_size : 0;
+    for (uint32_t i = 0; i < section_count; ++i)
+    {
+        uint32_t section_size = 0;
+        for (auto& block_view: section_block_views[i])
         {
-            output_file->_type = FileType::texture;
+            section_size += block_view.uncompressed_size;
+        }
+        section_sizes.push_back(section_size);
+        file_size += section_size;
+    }
 
-            // Extracts mipmap entries and the block sizes
-            uint32_t sections_count = extract<xiv_dat_logger, uint32_t>(_handle, "sections_count");
+    char* output = output_file->allocate(file_size, _file_allocator);
+    output_file->_data_sections.reserve(section_sizes.size());
+    for (auto section_size: section_sizes)
+    {
+        output_file->_data_sections.emplace_back(output, section_size);
+        output += section_size;
+    }
+
+    if (has_raw_header)
+    {
+        std::memcpy(output_file->_data, i_data + (i_layout.raw_header_offset - i_layout.offset), i_layout.raw_header_size);
+    }
+
+    // The output of every block is known up front, so they can be decompressed in any order
+    output = output_file->_data + (has_raw_header ? i_layout.raw_header_size : 0);
+    std::vector<std::pair<const BlockView*, char*>> block_outputs;
+    for (auto& block_views: section_block_views)
+    {
+        for (auto& block_view: block_views)
+        {
+            block_outputs.emplace_back(&block_view, output);
+            output += block_view.uncompressed_size;
+        }
+    }
+
+    if (_decode_pool && block_outputs.size() >= _parallel_decode_min_blocks)
+    {
+        // Big file: spread the blocks on the pool, each one writes to its own part of the sections
+        _decode_pool->parallel_for(block_outputs.size(), [&block_outputs](uint32_t i) {
+            decode_block(*block_outputs[i].first, block_outputs[i].second);
+        });
+    }
+    else
+    {
+        for (auto& block_output: block_outputs)
+        {
+            decode_block(*block_output.first, block_output.second);
+        }
+    }
+
+    return output_file;
+}
+
+void Dat::get_file_layout(uint32_t i_offset, FileLayout& o_layout) const
+{
+    // Extract the header of the file record
+    auto file_header = extract_at<DatFileHeader>(i_offset);
+
+    // Get the rest of the header (block infos) in one go and parse it from memory
+    std::vector<char> header_buffer;
+    const uint32_t header_data_size = std::max<uint32_t>(file_header.size, sizeof(DatFileHeader)) - sizeof(DatFileHeader);
+    auto header_data = get_data(i_offset + sizeof(DatFileHeader), header_data_size, header_buffer);
+    auto header_stream_ptr = utils::stream::get_istream(header_data, header_data_size);
+    auto& header_stream = *header_stream_ptr;
+
+    o_layout.type = file_header.entry_type;
+    o_layout.offset = i_offset;
+    o_layout.raw_header_offset = 0;
+    o_layout.raw_header_size = 0;
+    auto& section_block_offsets = o_layout.section_block_offsets;
+    auto& section_end_offsets = o_layout.section_end_offsets;
+    section_block_offsets.clear();
+    section_end_offsets.clear();
+
+    switch(file_header.entry_type)
+    {
+    case FileType::empty:
+        XIV_WARNING(xiv_dat_logger, "File is empty");
+        break;
 
-            std::vector<DatTexFileBlockInfos> tex_file_block_infos;
-            extract<xiv_dat_logger>(_handle, sections_count, tex_file_block_infos);
+    case FileType::standard:
+    {
+        uint32_t number_of_blocks = extract<xiv_dat_logger, uint32_t>(header_stream, "number_of_blocks");
 
-            // Extracting block sizes
-            uint32_t block_count = tex_file_block_infos.back().block_id + tex_file_block_infos.back().block_count;
-            std::vector<uint16_t> block_sizes;
-            extract<xiv_dat_logger>(_handle, "block_size", block_count, block_sizes);
+        // Just extract offset infos for the blocks to extract
+        std::vector<DatStdFileBlockInfos> std_file_block_infos;
+        extract<xiv_dat_logger, DatStdFileBlockInfos>(header_stream, number_of_blocks, std_file_block_infos);
 
-            output_file->_data_sections.resize(sections_count + 1);
+        // A single section for the whole file
+        section_block_offsets.resize(1);
+        section_end_offsets.resize(1);
+        for (auto& file_block_info: std_file_block_infos)
+        {
+            section_block_offsets[0].push_back(i_offset + file_header.size + file_block_info.offset);
+            section_end_offsets[0] = section_block_offsets[0].back() + file_block_info.size;
+        }
+    }
+    break;
 
-            // Extracting header in section 0
-            const uint32_t header_size = tex_file_block_infos.front().offset;
-            auto& header_section = output_file->_data_sections[0];
-            header_section.resize(header_size);
+    case FileType::model:
+    {
+        DatMdlFileBlockInfos mdl_file_block_infos = extract<xiv_dat_logger, DatMdlFileBlockInfos>(header_stream);
 
-            _handle.seekg(i_offset + file_header.size);
-            _handle.read(header_section.data(), header_size);
+        // Getting the block number and read their sizes
+        const uint32_t block_count = mdl_file_block_infos.block_ids[::model_section_count - 1] + mdl_file_block_infos.block_counts[::model_section_count - 1];
+        std::vector<uint16_t> block_sizes;
+        extract<xiv_dat_logger, uint16_t>(header_stream, "block_size", block_count, block_sizes);
 
-            // Extracting other sections
-            for (uint32_t i = 0; i < sections_count; ++i)
+        section_block_offsets.resize(::model_section_count);
+        section_end_offsets.resize(::model_section_count);
+        for (uint32_t i = 0; i < ::model_section_count; ++i)
+        {
+            uint32_t current_offset = i_offset + file_header.size + mdl_file_block_infos.offsets[i];
+            for (uint32_t j = 0; j < mdl_file_block_infos.block_counts[i]; ++j)
             {
-                auto& data_section = output_file->_data_sections[i + 1];
-                auto& section_infos = tex_file_block_infos[i];
-                data_section.reserve(section_infos.uncompressed_size);
+                section_block_offsets[i].push_back(current_offset);
+                current_offset += block_sizes.at(mdl_file_block_infos.block_ids[i] + j);
+            }
+            section_end_offsets[i] = current_offset;
+        }
+    }
+    break;
 
-                uint32_t current_offset = i_offset + file_header.size + section_infos.offset;
-                for (uint32_t j = 0; j < section_infos.block_count; ++j)
-                {
-                    extract_block(current_offset, data_section);
-                    current_offset += block_sizes[section_infos.block_id + j];
-                }
+    case FileType::texture:
+    {
+        // Extracts mipmap entries and the block sizes
+        uint32_t sections_count = extract<xiv_dat_logger, uint32_t>(header_stream, "sections_count");
+
+        std::vector<DatTexFileBlockInfos> tex_file_block_infos;
+        extract<xiv_dat_logger>(header_stream, sections_count, tex_file_block_infos);
+
+        // Extracting block sizes
+        uint32_t block_count = tex_file_block_infos.back().block_id + tex_file_block_infos.back().block_count;
+        std::vector<uint16_t> block_sizes;
+        extract<xiv_dat_logger>(header_stream, "block_size", block_count, block_sizes);
+
+        // The header of the texture is stored as is before the blocks
+        o_layout.raw_header_offset = i_offset + file_header.size;
+        o_layout.raw_header_size = tex_file_block_infos.front().offset;
+
+        // Mipmaps in the other sections
+        section_block_offsets.resize(sections_count);
+        section_end_offsets.resize(sections_count);
+        for (uint32_t i = 0; i < sections_count; ++i)
+        {
+            auto& section_infos = tex_file_block_infos[i];
+
+            uint32_t current_offset = i_offset + file_header.size + section_infos.offset;
+            for (uint32_t j = 0; j < section_infos.block_count; ++j)
+            {
+                section_block_offsets[i].push_back(current_offset);
+                current_offset += block_sizes.at(section_infos.block_id + j);
             }
+            section_end_offsets[i] = current_offset;
         }
+    }
+    break;
+
+    default:
+        throw std::runtime_error("Invalid entry_type: " + std::to_string(static_cast<uint32_t>(file_header.entry_type)));
         break;
+    }
 
-        default:
-            throw std::runtime_error("Invalid entry_type: " + std::to_string(static_cast<uint32_t>(file_header.entry_type)));
-            break;
+    // The file spans from its header to the end of its last part
+    o_layout.end_offset = std::max(i_offset + file_header.size, o_layout.raw_header_offset + o_layout.raw_header_size);
+    for (uint32_t i = 0; i < section_block_offsets.size(); ++i)
+    {
+        if (!section_block_offsets[i].empty())
+        {
+            o_layout.end_offset = std::max(o_layout.end_offset, section_end_offsets[i]);
         }
     }
-    return output_file;
 }
 
-void Dat::extract_block(uint32_t i_offset, std::vector<char>& o_data)
+void Dat::stream_file(uint32_t i_offset, const BlockSink& i_sink) const
 {
-    _handle.seekg(i_offset);
+    XIV_DEBUG(xiv_dat_logger, "Stream file nb: " << _nb << " - offset: " << i_offset);
+
+    FileLayout layout;
+    get_file_layout(i_offset, layout);
+
+    // Index of the first block-encoded section
+    uint32_t first_section = 0;
+    if (layout.type == FileType::texture)
+    {
+        // Header in section 0, it is not block-encoded
+        std::vector<char> header_buffer;
+        i_sink(0, get_data(layout.raw_header_offset, layout.raw_header_size, header_buffer), layout.raw_header_size);
+        first_section = 1;
+    }
+
+    // Split the sections in chunks of contiguous blocks of at most _stream_chunk_size bytes, at least one block each
+    struct Chunk
+    {
+        uint32_t section;
+        std::vector<uint32_t> block_offsets;
+        uint32_t end_offset;
+    };
+    std::vector<Chunk> chunks;
+    for (uint32_t i = 0; i < layout.section_block_offsets.size(); ++i)
+    {
+        auto& block_offsets = layout.section_block_offsets[i];
+        for (uint32_t j = 0; j < block_offsets.size(); ++j)
+        {
+            const uint32_t block_end_offset = (j + 1 < block_offsets.size()) ? block_offsets[j + 1] : layout.section_end_offsets[i];
+            if (chunks.empty() || chunks.back().section != i ||
+                block_end_offset - chunks.back().block_offsets.front() > _stream_chunk_size)
+            {
+                Chunk chunk;
+                chunk.section = i;
+                chunks.push_back(chunk);
+            }
+            chunks.back().block_offsets.push_back(block_offsets[j]);
+            chunks.back().end_offset = block_end_offset;
+        }
+    }
+
+    auto read_chunk = [this, &chunks](uint32_t i_chunk, std::vector<char>& io_buffer) {
+        auto& chunk = chunks[i_chunk];
+        return get_data(chunk.block_offsets.front(), chunk.end_offset - chunk.block_offsets.front(), io_buffer);
+    };
+    std::vector<BlockView> block_views;
+    std::vector<char> output;
+    auto decode_chunk = [&](uint32_t i_chunk, const char* i_chunk_data) {
+        block_views.clear();
+        parse_blocks(chunks[i_chunk].block_offsets, chunks[i_chunk].end_offset, i_chunk_data, block_views);
+        for (auto& block_view: block_views)
+        {
+            output.resize(block_view.uncompressed_size);
+            decode_block(block_view, output.data());
+            i_sink(first_section + chunks[i_chunk].section, output.data(), block_view.uncompressed_size);
+        }
+    };
 
-    DatBlockHeader block_header = extract<xiv_dat_logger, DatBlockHeader>(_handle);
+    if (_read_mode == ReadMode::mapped)
+    {
+        // Mapped reads are only pointer arithmetic, no need for another thread
+        std::vector<char> buffer;
+        for (uint32_t i = 0; i < chunks.size(); ++i)
+        {
+            decode_chunk(i, read_chunk(i, buffer));
+        }
+        return;
+    }
+
+    // Positional: a single reader thread for the whole stream reads the next chunk while this one decodes the current one
+    // Two buffers go back and forth between them, so at most two chunks are in memory
+    struct ChunkBuffer
+    {
+        std::vector<char> buffer;
+        const char* data;
+        std::exception_ptr exception;
+    };
+    utils::work_queue::BoundedQueue<ChunkBuffer> free_buffers(2);
+    utils::work_queue::BoundedQueue<ChunkBuffer> read_buffers(2);
+    free_buffers.push(ChunkBuffer());
+    free_buffers.push(ChunkBuffer());
+
+    std::thread reader([&] {
+        ChunkBuffer chunk_buffer;
+        for (uint32_t i = 0; i < chunks.size() && free_buffers.pop(chunk_buffer); ++i)
+        {
+            try
+            {
+                chunk_buffer.data = read_chunk(i, chunk_buffer.buffer);
+            }
+            catch (...)
+            {
+                // Handed to the decoding side, which rethrows it
+                chunk_buffer.exception = std::current_exception();
+                read_buffers.push(std::move(chunk_buffer));
+                return;
+            }
+            if (!read_buffers.push(std::move(chunk_buffer)))
+            {
+                return;
+            }
+        }
+    });
+
+    try
+    {
+        ChunkBuffer chunk_buffer;
+        for (uint32_t i = 0; i < chunks.size(); ++i)
+        {
+            if (!read_buffers.pop(chunk_buffer))
+            {
+                throw std::runtime_error("Stream reader stopped early - offset: " + std::to_string(i_offset));
+            }
+            if (chunk_buffer.exception)
+            {
+                std::rethrow_exception(chunk_buffer.exception);
+            }
+            decode_chunk(i, chunk_buffer.data);
+            free_buffers.push(std::move(chunk_buffer));
+        }
+    }
+    catch (...)
+    {
+        // The reader may wait on either queue, closing both lets it return
+        free_buffers.close();
+        read_buffers.close();
+        reader.join();
+        throw;
+    }
+    reader.join();
+}
+
+void Dat::extract_block(uint32_t i_offset, std::vector<char>& o_data, std::vector<char>& io_buffer) const
+{
+    auto block_view = get_block_view(i_offset, io_buffer);
 
     // Resizing the vector to write directly into it
     const uint32_t data_size = o_data.size();
-    o_data.resize(data_size + block_header.uncompressed_size);
+    o_data.resize(data_size + block_view.uncompressed_size);
 
-    // 32000 in compressed_size means it is not compressed so take uncompressed_size
-    if (block_header.compressed_size == 32000)
+    decode_block(block_view, o_data.data() + data_size);
+}
+
+Dat::BlockView Dat::get_block_view(uint32_t i_offset, std::vector<char>& io_buffer) const
+{
+    DatBlockHeader block_header = extract_at<DatBlockHeader>(i_offset, utils::log::Severity::trace);
+
+    BlockView block_view = make_block_view(block_header);
+    block_view.data = get_data(i_offset + sizeof(DatBlockHeader), block_view.size, io_buffer);
+    return block_view;
+}
+
+void Dat::decode_block(const BlockView& i_block_view, char* o_output)
+{
+    if (!i_block_view.is_compressed)
     {
-        _handle.read(o_data.data() + data_size, block_header.uncompressed_size);
+        std::memcpy(o_output, i_block_view.data, i_block_view.uncompressed_size);
     }
     else
     {
-        // If it is compressed use zlib
-        // Read the data to be decompressed
-        std::vector<char> temp_buffer(block_header.compressed_size);
-        _handle.read(temp_buffer.data(), block_header.compressed_size);
+        // If it is compressed use zlib, straight from the view
+        utils::zlib::no_header_decompress(reinterpret_cast<const uint8_t*>(i_block_view.data),
+                                          i_block_view.size,
+                                          reinterpret_cast<uint8_t*>(o_output),
+                                          i_block_view.uncompressed_size);
+    }
+}
+
+void Dat::gather_blocks(const std::vector<uint32_t>& i_block_offsets, uint32_t i_end_offset, std::vector<char>& io_buffer, std::vector<BlockView>& o_block_views) const
+{
+    if (i_block_offsets.empty())
+    {
+        return;
+    }
 
-        utils::zlib::no_header_decompress(reinterpret_cast<uint8_t*>(temp_buffer.data()),
-                                          temp_buffer.size(),
-                                          reinterpret_cast<uint8_t*>(o_data.data() + data_size),
-                                          block_header.uncompressed_size);
+    // The blocks of a section are contiguous, so get all of them at once
+    auto span_data = get_data(i_block_offsets.front(), i_end_offset - i_block_offsets.front(), io_buffer);
+    parse_blocks(i_block_offsets, i_end_offset, span_data, o_block_views);
+}
+
+void Dat::parse_blocks(const std::vector<uint32_t>& i_block_offsets, uint32_t i_end_offset, const char* i_span_data, std::vector<BlockView>& o_block_views)
+{
+    const uint32_t start_offset = i_block_offsets.front();
+    const uint32_t span_size = i_end_offset - start_offset;
+
+    o_block_views.reserve(i_block_offsets.size());
+    for (auto block_offset: i_block_offsets)
+    {
+        const uint32_t relative_offset = block_offset - start_offset;
+        if (relative_offset + sizeof(DatBlockHeader) > span_size)
+        {
+            throw std::runtime_error("Block header out of its section - offset: " + std::to_string(block_offset));
+        }
+
+        // Parse the header straight from the gathered bytes
+        DatBlockHeader block_header;
+        std::memcpy(&block_header, i_span_data + relative_offset, sizeof(DatBlockHeader));
+        utils::bparse::reorder(block_header);
+        XIV_TRACE(xiv_dat_logger, "Extracted: " << block_header);
+
+        BlockView block_view = make_block_view(block_header);
+        if (relative_offset + sizeof(DatBlockHeader) + block_view.size > span_size)
+        {
+            throw std::runtime_error("Block data out of its section - offset: " + std::to_string(block_offset));
+        }
+        block_view.data = i_span_data + relative_offset + sizeof(DatBlockHeader);
+        o_block_views.push_back(block_view);
     }
 }
 
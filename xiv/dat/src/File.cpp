@@ -1,19 +1,62 @@
 #include <xiv/dat/File.h>
 
 #include <fstream>
+#include <stdexcept>
 
 namespace xiv
 {
 namespace dat
 {
 
+DataSection::DataSection(const char* i_data, std::size_t i_size) :
+    _data(i_data),
+    _size(i_size)
+{
+}
+
+const char* DataSection::data() const
+{
+    return _data;
+}
+
+std::size_t DataSection::size() const
+{
+    return _size;
+}
+
+bool DataSection::empty() const
+{
+    return _size == 0;
+}
+
+const char* DataSection::begin() const
+{
+    return _data;
+}
+
+const char* DataSection::end() const
+{
+    return _data + _size;
+}
+
 File::File() :
-    _type(FileType::empty)
+    _type(FileType::empty),
+    _allocator(nullptr),
+    _data(nullptr),
+    _size(0)
 {
 }
 
 File::~File()
 {
+    if (_allocator)
+    {
+        _allocator->deallocate(_data, _size);
+    }
+    else
+    {
+        delete[] _data;
+    }
 }
 
 FileType File::get_type() const
@@ -21,24 +64,40 @@ FileType File::get_type() const
     return _type;
 }
 
-const std::vector<std::vector<char>>& File::get_data_sections() const
+const std::vector<DataSection>& File::get_data_sections() const
 {
     return _data_sections;
 }
 
-std::vector<std::vector<char>>& File::access_data_sections()
+const char* File::get_data() const
 {
-    return _data_sections;
+    return _data;
+}
+
+std::size_t File::get_size() const
+{
+    return _size;
 }
 
 void File::export_as_bin(const boost::filesystem::path& i_path) const
 {
+    // Sections are contiguous, so the whole data goes in one write
     std::ofstream ofs(i_path.string(), std::ios_base::binary | std::ios_base::out);
-    for (auto& data_section: _data_sections)
+    ofs.write(_data, _size);
+    ofs.close();
+    if (!ofs)
     {
-        ofs.write(data_section.data(), data_section.size());
+        throw std::runtime_error("Failed to write file: " + i_path.string());
     }
-    ofs.close();
+}
+
+char* File::allocate(std::size_t i_size, FileAllocator* i_allocator)
+{
+    // No value-initialization: every byte is written by the decoding right after
+    _data = i_allocator ? i_allocator->allocate(i_size) : new char[i_size];
+    _allocator = i_allocator;
+    _size = i_size;
+    return _data;
 }
 
 }
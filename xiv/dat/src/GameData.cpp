@@ -3,35 +3,37 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <map>
+#include <fstream>
 
-#include <boost/assign/list_of.hpp>
-#include <boost/bimap.hpp>
-
-#include <zlib.h>
+#include <boost/format.hpp>
 
 #include <xiv/utils/bparse.h>
+#include <xiv/utils/thread_pool.h>
 #include <xiv/dat/logger.h>
 #include <xiv/dat/Cat.h>
 #include <xiv/dat/File.h>
+#include <xiv/dat/Index.h>
+#include <xiv/dat/Dat.h>
 
 namespace
 {
-// Relation between category number and category name
-// These names are taken straight from the exe, it helps resolve dispatching when getting files by path
-boost::bimap<std::string, uint32_t> category_map = boost::assign::list_of<boost::bimap<std::string, uint32_t>::relation>
-        ("common",          0x00)
-        ("bgcommon",        0x01)
-        ("bg",              0x02)
-        ("cut",             0x03)
-        ("chara",           0x04)
-        ("shader",          0x05)
-        ("ui",              0x06)
-        ("sound",           0x07)
-        ("vfx",             0x08)
-        ("ui_script",       0x09)
-        ("exd",             0x0A)
-        ("game_script",     0x0B)
-        ("music",           0x0C);
+// Whether a path from the dictionary stays inside the dir it is appended to: relative, without any . or .. component
+bool is_contained_path(const boost::filesystem::path& i_path)
+{
+    if (i_path.empty() || i_path.has_root_path())
+    {
+        return false;
+    }
+    for (auto& element : i_path)
+    {
+        if (element.empty() || element == "." || element == "..")
+        {
+            return false;
+        }
+    }
+    return true;
+}
 }
 
 namespace xiv
@@ -39,10 +41,11 @@ namespace xiv
 namespace dat
 {
 
-GameData::GameData(const boost::filesystem::path& i_path) try :
-    _path(i_path)
+GameData::GameData(const boost::filesystem::path& i_path, const Options& i_options) try :
+    _path(i_path),
+    _options(i_options)
 {
-    XIV_INFO(xiv_dat_logger, "Initializing GameData with path: " << _path);
+    XIV_INFO(xiv_dat_logger, "Initializing GameData with path: " << _path << " - read_mode: " << _options.read_mode);
 
     // Iterate over the files in i_path
     for (auto it = boost::filesystem::directory_iterator(_path); it != boost::filesystem::directory_iterator(); ++it)
@@ -58,12 +61,47 @@ GameData::GameData(const boost::filesystem::path& i_path) try :
             uint32_t cat_nb;
             iss >> std::hex >> cat_nb;
 
-            // Add to the list of category number
-            // creates the empty category in the cats map
-            // instantiate the creation mutex for this category
+            if (cat_nb >= cat_slot_count)
+            {
+                XIV_WARNING(xiv_dat_logger, "Ignoring index with invalid category number: " << filename);
+                continue;
+            }
+
+            // Add to the list of category number, the category itself is created on first use
             _cat_nbs.push_back(cat_nb);
-            _cats[cat_nb] = std::unique_ptr<Cat>();
-            _cat_creation_mutexes[cat_nb] = std::unique_ptr<std::mutex>(new std::mutex());
+            _cat_slots[cat_nb].exists = true;
+        }
+    }
+
+    if (!_options.path_dictionary_path.empty())
+    {
+        // The names are only a convenience, the dats can be read without them
+        try
+        {
+            _path_dictionary.reset(new PathDictionary(_options.path_dictionary_path));
+        }
+        catch (std::exception& e)
+        {
+            XIV_WARNING(xiv_dat_logger, "Path dictionary not loaded: " << _options.path_dictionary_path << " - " << e.what());
+        }
+    }
+
+    if (_options.open_all_categories)
+    {
+        // Each category parses its own .index, so they can all be opened at the same time
+        auto open_categories = [this](utils::thread_pool::ThreadPool& i_pool) {
+            i_pool.parallel_for(_cat_nbs.size(), [this](uint32_t i) {
+                create_category(_cat_nbs[i]);
+            });
+        };
+        if (_options.decode_pool)
+        {
+            open_categories(*_options.decode_pool);
+        }
+        else
+        {
+            utils::thread_pool::ThreadPool open_pool;
+            open_categories(open_pool);
         }
     }
 }
@@ -79,6 +117,12 @@ GameData::~GameData()
 
 }
 
+GameData::CategorySlot::CategorySlot() :
+    exists(false),
+    cat(nullptr)
+{
+}
+
 const std::vector<uint32_t>& GameData::get_cat_nbs() const
 {
     return _cat_nbs;
@@ -87,123 +131,331 @@ const std::vector<uint32_t>& GameData::get_cat_nbs() const
 std::unique_ptr<File> GameData::get_file(const std::string& i_path)
 {
     XIV_INFO(xiv_dat_logger, "Get file: " << i_path);
+    return get_file(PathHash(i_path));
+}
 
-    // Get the hashes, the category from the path then call the get_file of the category
-    uint32_t dir_hash;
-    uint32_t filename_hash;
-    get_hashes(i_path, dir_hash, filename_hash);
+std::unique_ptr<File> GameData::get_file(const PathHash& i_path_hash)
+{
+    return get_category(i_path_hash.get_cat_nb()).get_file(i_path_hash.get_dir_hash(), i_path_hash.get_filename_hash());
+}
 
-    return get_category_from_path(i_path).get_file(dir_hash, filename_hash);
+void GameData::get_files(const std::vector<std::string>& i_paths, const FileCallback& i_callback)
+{
+    XIV_INFO(xiv_dat_logger, "Get files: " << i_paths.size());
+
+    std::vector<PathHash> path_hashes;
+    path_hashes.reserve(i_paths.size());
+    for (auto& path: i_paths)
+    {
+        path_hashes.emplace_back(path);
+    }
+    get_files(path_hashes, i_callback);
 }
 
-bool GameData::check_file_existence(const std::string& i_path)
+void GameData::get_files(const std::vector<PathHash>& i_path_hashes, const FileCallback& i_callback)
 {
-    uint32_t dir_hash;
-    uint32_t filename_hash;
-    get_hashes(i_path, dir_hash, filename_hash);
+    // Group the hashes by category, keeping track of where each file was in the request
+    std::map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>> cat_hashes;
+    std::map<uint32_t, std::vector<uint32_t>> cat_indices;
+    for (uint32_t i = 0; i < i_path_hashes.size(); ++i)
+    {
+        auto& path_hash = i_path_hashes[i];
+        cat_hashes[path_hash.get_cat_nb()].emplace_back(path_hash.get_dir_hash(), path_hash.get_filename_hash());
+        cat_indices[path_hash.get_cat_nb()].push_back(i);
+    }
 
-    return get_category_from_path(i_path).check_file_existence(dir_hash, filename_hash);
+    for (auto& cat_hashes_entry: cat_hashes)
+    {
+        auto& indices = cat_indices[cat_hashes_entry.first];
+        get_category(cat_hashes_entry.first).get_files(cat_hashes_entry.second, [&indices, &i_callback](uint32_t i_index, std::unique_ptr<File> i_file) {
+            i_callback(indices[i_index], std::move(i_file));
+        });
+    }
 }
 
-bool GameData::check_dir_existence(const std::string& i_path)
+std::vector<std::unique_ptr<File>> GameData::get_files(const std::vector<std::string>& i_paths)
+{
+    std::vector<std::unique_ptr<File>> files(i_paths.size());
+    get_files(i_paths, [&files](uint32_t i_index, std::unique_ptr<File> i_file) {
+        files[i_index] = std::move(i_file);
+    });
+    return files;
+}
+
+void GameData::stream_file(const std::string& i_path, const BlockSink& i_sink)
 {
-    uint32_t dir_hash;
-    uint32_t filename_hash;
-    get_hashes(i_path, dir_hash, filename_hash);
+    XIV_INFO(xiv_dat_logger, "Stream file: " << i_path);
 
-    return get_category_from_path(i_path).check_dir_existence(dir_hash);
+    PathHash path_hash(i_path);
+    get_category(path_hash.get_cat_nb()).stream_file(path_hash.get_dir_hash(), path_hash.get_filename_hash(), i_sink);
 }
 
-const Cat& GameData::get_category(uint32_t i_cat_nb)
+void GameData::export_file_as_bin(const std::string& i_path, const boost::filesystem::path& i_output_path)
 {
-    // Check that the category number exists
-    auto cat_it = _cats.find(i_cat_nb);
-    if (cat_it == _cats.end())
+    std::ofstream ofs(i_output_path.string(), std::ios_base::binary | std::ios_base::out);
+    stream_file(i_path, [&ofs](uint32_t, const char* i_data, uint32_t i_size) {
+        ofs.write(i_data, i_size);
+    });
+    ofs.close();
+    if (!ofs)
     {
-        throw std::runtime_error("Category not found: " + std::to_string(i_cat_nb));
+        throw std::runtime_error("Failed to write file: " + i_output_path.string());
     }
+}
+
+uint64_t GameData::export_category(uint32_t i_cat_nb, const boost::filesystem::path& i_output_path, utils::thread_pool::ThreadPool* i_pool)
+{
+    auto& cat = get_category(i_cat_nb);
+    auto& index = cat.get_index();
+    auto& entries = index.get_entries();
+
+    XIV_INFO(xiv_dat_logger, "Export category: " << cat.get_name() << " - files: " << entries.size() << " - to: " << i_output_path);
 
-    // If it exists and already instantiated return it
-    if (cat_it->second)
+    // Output paths and their dirs first, so that the workers only have to write the files
+    std::vector<boost::filesystem::path> output_paths(entries.size());
+    std::vector<boost::filesystem::path> output_dirs;
+    for (uint32_t i = 0; i < entries.size(); ++i)
     {
-        return *(cat_it->second);
+        // The dictionary is an input file, a path escaping i_output_path is named by its hashes like an unknown one
+        const boost::filesystem::path path = find_path(PathHash(i_cat_nb, entries[i].dir_hash, entries[i].filename_hash));
+        if (is_contained_path(path))
+        {
+            output_paths[i] = i_output_path / path;
+        }
+        else
+        {
+            if (!path.empty())
+            {
+                XIV_WARNING(xiv_dat_logger, "Path not contained in the output dir, exported by its hashes: " << path);
+            }
+            output_paths[i] = i_output_path / "unknown" / cat.get_name() / (boost::format("%08x") % entries[i].dir_hash).str() /
+                              (boost::format("%08x") % entries[i].filename_hash).str();
+        }
+        output_dirs.push_back(output_paths[i].parent_path());
+    }
+    std::sort(output_dirs.begin(), output_dirs.end());
+    output_dirs.erase(std::unique(output_dirs.begin(), output_dirs.end()), output_dirs.end());
+    for (auto& output_dir : output_dirs)
+    {
+        boost::filesystem::create_directories(output_dir);
+    }
+
+    // Entries split by dat, each dat then sorts its own by offset
+    std::vector<std::vector<uint32_t>> dat_offsets(index.get_dat_count());
+    std::vector<std::vector<uint32_t>> dat_indices(index.get_dat_count());
+    for (uint32_t i = 0; i < entries.size(); ++i)
+    {
+        dat_offsets.at(entries[i].dat_nb).push_back(entries[i].dat_offset);
+        dat_indices.at(entries[i].dat_nb).push_back(i);
+    }
+
+    std::atomic<uint64_t> total_size(0);
+    auto export_files = [&](utils::thread_pool::ThreadPool& i_pool) {
+        for (uint32_t i = 0; i < dat_offsets.size(); ++i)
+        {
+            auto& indices = dat_indices[i];
+            cat.get_dat(i).get_files(dat_offsets[i], [&](uint32_t i_index, std::unique_ptr<File> i_file) {
+                // Throws on a failed write, which stops the export, so only the files written entirely are counted
+                i_file->export_as_bin(output_paths[indices[i_index]]);
+                total_size += i_file->get_size();
+            }, i_pool);
+        }
+    };
+    if (i_pool || _options.decode_pool)
+    {
+        export_files(i_pool ? *i_pool : *_options.decode_pool);
     }
     else
     {
-        // Else create it and return it
-        create_category(i_cat_nb);
-        return *(_cats[i_cat_nb]);
+        utils::thread_pool::ThreadPool export_pool;
+        export_files(export_pool);
     }
+
+    return total_size;
 }
 
-const Cat& GameData::get_category(const std::string& i_cat_name)
+uint64_t GameData::export_all(const boost::filesystem::path& i_output_path, utils::thread_pool::ThreadPool* i_pool)
 {
-    // Find the category number from the name
-    auto category_map_it = ::category_map.left.find(i_cat_name);
-    if (category_map_it == ::category_map.left.end())
+    uint64_t total_size = 0;
+    for (auto cat_nb : _cat_nbs)
     {
-        throw std::runtime_error("Category not found: " + i_cat_name);
+        total_size += export_category(cat_nb, i_output_path, i_pool);
     }
+    return total_size;
+}
 
-    // From the category number return the category
-    return get_category(category_map_it->second);
+bool GameData::check_file_existence(const std::string& i_path)
+{
+    return check_file_existence(PathHash(i_path));
+}
+
+bool GameData::check_file_existence(const PathHash& i_path_hash)
+{
+    return get_category(i_path_hash.get_cat_nb()).check_file_existence(i_path_hash.get_dir_hash(), i_path_hash.get_filename_hash());
+}
+
+bool GameData::check_dir_existence(const std::string& i_path)
+{
+    return check_dir_existence(PathHash(i_path));
+}
+
+bool GameData::check_dir_existence(const PathHash& i_path_hash)
+{
+    return get_category(i_path_hash.get_cat_nb()).check_dir_existence(i_path_hash.get_dir_hash());
 }
 
-const Cat& GameData::get_category_from_path(const std::string& i_path)
+void GameData::search_paths(const std::vector<PathPattern>& i_patterns, const PathCallback& i_callback, utils::thread_pool::ThreadPool* i_pool)
 {
-    // Find the first / in the string, paths are in the format CAT_NAME/..../.../../....
-    auto first_slash_pos = i_path.find('/');
-    if (first_slash_pos == std::string::npos)
+    // Categories are opened before going wide, the patterns then only read their indexes
+    std::vector<const Index*> indexes;
+    for (auto& pattern : i_patterns)
     {
-        throw std::runtime_error("Path do not have a / char: " + i_path);
+        indexes.push_back(&get_category(pattern.get_cat_nb()).get_index());
     }
 
-    // From the sub string found beforethe first / get the category
-    std::string cat_name = i_path.substr(0, first_slash_pos);
-    XIV_INFO(xiv_dat_logger, "get_category_from_path: " << i_path << " - " << cat_name);
-    return get_category(cat_name);
+    // The patterns are tasks of the pool as well as their own dir and file sweeps, so no thread waits on another pattern
+    auto search_patterns = [&](utils::thread_pool::ThreadPool& i_pool) {
+        i_pool.parallel_for(i_patterns.size(), [&](uint32_t i) {
+            i_patterns[i].search(*indexes[i], i_callback, i_pool);
+        });
+    };
+    if (i_pool || _options.decode_pool)
+    {
+        search_patterns(i_pool ? *i_pool : *_options.decode_pool);
+    }
+    else
+    {
+        utils::thread_pool::ThreadPool search_pool;
+        search_patterns(search_pool);
+    }
+}
+
+std::string GameData::find_path(const PathHash& i_path_hash) const
+{
+    return _path_dictionary ? _path_dictionary->find_path(i_path_hash) : std::string();
+}
+
+std::string GameData::find_dir_path(uint32_t i_cat_nb, uint32_t i_dir_hash) const
+{
+    return _path_dictionary ? _path_dictionary->find_dir_path(i_cat_nb, i_dir_hash) : std::string();
+}
+
+const PathDictionary* GameData::get_path_dictionary() const
+{
+    return _path_dictionary.get();
 }
 
-void GameData::get_hashes(const std::string& i_path, uint32_t& o_dir_hash, uint32_t& o_filename_hash) const
+VerifyResult GameData::verify(utils::thread_pool::ThreadPool* i_pool)
 {
-    // Convert the path to lowercase before getting the hashes
-    std::string path_lower;
-    path_lower.resize(i_path.size());
-    std::transform(i_path.begin(), i_path.end(), path_lower.begin(), ::tolower);
+    VerifyResult result;
+    result.file_count = 0;
+    result.block_count = 0;
+    result.size = 0;
+    std::mutex result_mutex;
+
+    auto verify_blocks = [&](utils::thread_pool::ThreadPool& i_pool) {
+        // Opening the categories parses their .index, so they are opened in parallel too
+        i_pool.parallel_for(_cat_nbs.size(), [this](uint32_t i) {
+            create_category(_cat_nbs[i]);
+        });
+
+        std::vector<const SqPack*> sqpacks;
+        for (auto cat_nb : _cat_nbs)
+        {
+            auto& cat = get_category(cat_nb);
+            sqpacks.push_back(&cat.get_index());
+            for (uint32_t i = 0; i < cat.get_index().get_dat_count(); ++i)
+            {
+                sqpacks.push_back(&cat.get_dat(i));
+            }
+        }
+
+        // One task per block, the largest first: a whole .datX is a single SHA-1 so it must not be the last to start
+        std::vector<std::pair<const SqPack*, const SqPack::HashedBlock*>> blocks;
+        for (auto sqpack : sqpacks)
+        {
+            for (auto& hashed_block : sqpack->get_hashed_blocks())
+            {
+                blocks.emplace_back(sqpack, &hashed_block);
+                result.size += hashed_block.size;
+            }
+        }
+        std::stable_sort(blocks.begin(), blocks.end(), [](const std::pair<const SqPack*, const SqPack::HashedBlock*>& i_lhs,
+                                                          const std::pair<const SqPack*, const SqPack::HashedBlock*>& i_rhs) {
+            return i_lhs.second->size > i_rhs.second->size;
+        });
+        result.file_count = sqpacks.size();
+        result.block_count = blocks.size();
+
+        i_pool.parallel_for(blocks.size(), [&](uint32_t i) {
+            auto& sqpack = *blocks[i].first;
+            auto& hashed_block = *blocks[i].second;
+            if (!sqpack.is_block_valid(hashed_block))
+            {
+                std::ostringstream oss;
+                oss << sqpack.get_path().string() << " - offset: " << hashed_block.offset << " - size: " << hashed_block.size;
+                XIV_ERROR(xiv_dat_logger, "Invalid block: " << oss.str());
+
+                std::lock_guard<std::mutex> lock(result_mutex);
+                result.invalid_blocks.push_back(oss.str());
+            }
+        });
+    };
+    if (i_pool || _options.decode_pool)
+    {
+        verify_blocks(i_pool ? *i_pool : *_options.decode_pool);
+    }
+    else
+    {
+        utils::thread_pool::ThreadPool verify_pool;
+        verify_blocks(verify_pool);
+    }
+
+    // Same order whatever the scheduling
+    std::sort(result.invalid_blocks.begin(), result.invalid_blocks.end());
+
+    XIV_INFO(xiv_dat_logger, "Verified " << result.file_count << " files - " << result.block_count << " blocks - "
+             << result.size << " bytes - " << result.invalid_blocks.size() << " invalid");
+    return result;
+}
 
-    // Find last / to separate dir from filename
-    auto last_slash_pos = path_lower.rfind('/');
-    if (last_slash_pos == std::string::npos)
+const Cat& GameData::get_category(uint32_t i_cat_nb)
+{
+    // Check that the category number exists
+    if ((i_cat_nb >= cat_slot_count) || !_cat_slots[i_cat_nb].exists)
     {
-        throw std::runtime_error("Path do not have a / char: " + i_path);
+        throw std::runtime_error("Category not found: " + std::to_string(i_cat_nb));
     }
 
-    std::string dir_part = path_lower.substr(0, last_slash_pos);
-    std::string filename_part = path_lower.substr(last_slash_pos + 1);
+    // If it is already instantiated return it, else create it
+    auto cat = _cat_slots[i_cat_nb].cat.load(std::memory_order_acquire);
+    if (!cat)
+    {
+        cat = create_category(i_cat_nb);
+    }
+    return *cat;
+}
 
-    // Get the crc32 values from zlib, to compensate the final XOR 0xFFFFFFFF that isnot done in the exe we just reXOR
-    o_dir_hash = crc32(0, reinterpret_cast<const uint8_t*>(dir_part.data()), dir_part.size()) ^ 0xFFFFFFFF;
-    o_filename_hash = crc32(0, reinterpret_cast<const uint8_t*>(filename_part.data()), filename_part.size()) ^ 0xFFFFFFFF;
+const Cat& GameData::get_category(const std::string& i_cat_name)
+{
+    // From the category number return the category
+    return get_category(get_category_nb(i_cat_name));
 }
 
-void GameData::create_category(uint32_t i_cat_nb)
+const Cat* GameData::create_category(uint32_t i_cat_nb)
 {
+    auto& cat_slot = _cat_slots[i_cat_nb];
+
     // Lock mutex in this scope
-    std::lock_guard<std::mutex> lock(*(_cat_creation_mutexes[i_cat_nb]));
+    std::lock_guard<std::mutex> lock(cat_slot.creation_mutex);
     // Maybe after unlocking it has already been created, so check (most likely if it blocked)
-    if (!_cats[i_cat_nb])
+    if (!cat_slot.owned_cat)
     {
-        // Get the category name if we have it
-        std::string cat_name;
-        auto category_map_it = ::category_map.right.find(i_cat_nb);
-        if (category_map_it != ::category_map.right.end())
-        {
-            cat_name = category_map_it->second;
-        }
-
-        // Actually creates the category
-        _cats[i_cat_nb] = std::unique_ptr<Cat>(new Cat(_path, i_cat_nb, cat_name));
+        // Actually creates the category with its name if we have it, then publishes it for the lock-free lookups
+        cat_slot.owned_cat = std::unique_ptr<Cat>(new Cat(_path, i_cat_nb, get_category_name(i_cat_nb), _options));
+        cat_slot.cat.store(cat_slot.owned_cat.get(), std::memory_order_release);
     }
+    return cat_slot.owned_cat.get();
 }
 
 }
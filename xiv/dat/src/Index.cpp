@@ -1,5 +1,10 @@
 #include <xiv/dat/Index.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+
 #include <xiv/utils/bparse.h>
 
 #include <xiv/dat/logger.h>
@@ -22,46 +27,81 @@ namespace xiv
 namespace dat
 {
 
-Index::Index(const boost::filesystem::path& i_path) :
-    SqPack(i_path)
+// Header of an index cache file, followed by the entries, the dirs and the dir slots as they are in memory
+// The cache is a local artifact, so it is written in native layout and endianness
+struct IndexCacheHeader
 {
-    // Hash Table record
-    auto hash_table_block_record = extract<xiv_dat_logger, IndexBlockRecord>(_handle);
-    is_index_block_valid(hash_table_block_record);
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    // Key of the .index the tables were built from
+    uint64_t index_size;
+    int64_t index_write_time;
+    uint8_t hash_table_hash[0x14];
+    // Sizes of the tables
+    uint32_t entry_count;
+    uint32_t dir_count;
+    uint32_t dir_slot_count;
+};
 
-    // Save the posin the stream to go back to it later on
-    auto pos = _handle.tellg();
-
-    // Seek to the pos of the hash table in the file
-    _handle.seekg(hash_table_block_record.offset);
+namespace
+{
+const char index_cache_magic[8] = "XIVIDXC";
+// To bump whenever the layout of the tables changes
+const uint32_t index_cache_version = 1;
+}
 
-    // Preallocate and extract the index_hash_table_entries
-    std::vector<IndexHashTableEntry> index_hash_table_entries;
-    extract<xiv_dat_logger>(_handle, hash_table_block_record.size / sizeof(IndexHashTableEntry), index_hash_table_entries, utils::log::Severity::trace);
+Index::Index(const boost::filesystem::path& i_path, const Options& i_options) :
+    SqPack(i_path, i_options.read_mode)
+{
+    // Hash Table record
+    uint32_t header_offset = _sub_header_offset;
+    auto hash_table_block_record = extract_at<IndexBlockRecord>(header_offset);
+    header_offset += sizeof(IndexBlockRecord);
+    add_index_block(hash_table_block_record);
 
-    // Feed the correct entry in the HashTable for each index_hash_table_entry
-    for (auto& index_hash_table_entry: index_hash_table_entries)
+    // Load the tables built by a previous run if the .index did not change since, build them otherwise
+    boost::filesystem::path cache_path;
+    IndexCacheHeader cache_header;
+    if (!i_options.index_cache_path.empty())
     {
-        auto& hash_table_entry = _hash_table[index_hash_table_entry.dir_hash][index_hash_table_entry.filename_hash];
-        // The dat number is found in the offset, last four bits
-        hash_table_entry.dat_nb = (index_hash_table_entry.dat_offset & 0xF) / 0x2;
-        // The offset in the dat file, needs to strip the dat number indicator
-        hash_table_entry.dat_offset = (index_hash_table_entry.dat_offset & 0xFFFFFFF0) * 0x08;
-        hash_table_entry.dir_hash = index_hash_table_entry.dir_hash;
-        hash_table_entry.filename_hash = index_hash_table_entry.filename_hash;
+        cache_path = i_options.index_cache_path / (i_path.filename().string() + ".cache");
+
+        std::memset(&cache_header, 0, sizeof(cache_header));
+        std::memcpy(cache_header.magic, index_cache_magic, sizeof(cache_header.magic));
+        cache_header.version = index_cache_version;
+        cache_header.entry_size = sizeof(HashTableEntry);
+        cache_header.index_size = boost::filesystem::file_size(i_path);
+        cache_header.index_write_time = boost::filesystem::last_write_time(i_path);
+        std::memcpy(cache_header.hash_table_hash, hash_table_block_record.block_hash.hash, sizeof(cache_header.hash_table_hash));
     }
 
-    // Come back to where we were before reading the HashTable
-    _handle.seekg(pos);
+    if (cache_path.empty() || !load_cache(cache_path, cache_header))
+    {
+        read_hash_table(hash_table_block_record);
+        build_dir_table();
+
+        if (!cache_path.empty())
+        {
+            save_cache(cache_path, cache_header);
+        }
+    }
 
     // Dat Count
-    _dat_count = extract<xiv_dat_logger, uint32_t>(_handle, "dat_count");
+    _dat_count = extract_at<uint32_t>(header_offset);
+    header_offset += sizeof(uint32_t);
 
     // Free List
-    is_index_block_valid(extract<xiv_dat_logger, IndexBlockRecord>(_handle));
+    add_index_block(extract_at<IndexBlockRecord>(header_offset));
+    header_offset += sizeof(IndexBlockRecord);
 
     // Dir Hash Table
-    is_index_block_valid(extract<xiv_dat_logger, IndexBlockRecord>(_handle));
+    add_index_block(extract_at<IndexBlockRecord>(header_offset));
+
+    if (i_options.verify_blocks)
+    {
+        check_hashed_blocks();
+    }
 }
 
 Index::~Index()
@@ -73,54 +113,280 @@ uint32_t Index::get_dat_count() const
     return _dat_count;
 }
 
-const Index::HashTable& Index::get_hash_table() const
+const std::vector<Index::HashTableEntry>& Index::get_entries() const
 {
-    return _hash_table;
+    return _entries;
+}
+
+const std::vector<Index::DirEntry>& Index::get_dirs() const
+{
+    return _dirs;
 }
 
 bool Index::check_file_existence(uint32_t dir_hash, uint32_t filename_hash) const
 {
-    auto dir_it = get_hash_table().find(dir_hash);
-    if (dir_it != get_hash_table().end())
-    {
-        return (dir_it->second.find(filename_hash) != dir_it->second.end());
-    }
-    return false;
+    return find_entry(dir_hash, filename_hash) != nullptr;
 }
 bool Index::check_dir_existence(uint32_t dir_hash) const
 {
-    return (get_hash_table().find(dir_hash) != get_hash_table().end());
+    return find_dir(dir_hash) != nullptr;
 }
 
-const Index::DirHashTable& Index::get_dir_hash_table(uint32_t dir_hash) const
+const Index::DirEntry* Index::find_dir(uint32_t dir_hash) const
 {
-    auto dir_it = get_hash_table().find(dir_hash);
-    if (dir_it == get_hash_table().end())
+    const uint32_t slot_mask = _dir_slots.size() - 1;
+    for (uint32_t slot = dir_hash & slot_mask; _dir_slots[slot] != 0; slot = (slot + 1) & slot_mask)
     {
-        throw std::runtime_error("dir_hash not found");
+        auto& dir_entry = _dirs[_dir_slots[slot] - 1];
+        if (dir_entry.dir_hash == dir_hash)
+        {
+            return &dir_entry;
+        }
     }
-    else
+    return nullptr;
+}
+
+const Index::HashTableEntry* Index::find_entry(const DirEntry& i_dir_entry, uint32_t filename_hash) const
+{
+    auto begin = _entries.data() + i_dir_entry.first_entry;
+    auto end = begin + i_dir_entry.entry_count;
+    auto entry_it = std::lower_bound(begin, end, filename_hash,
+                                     [](const HashTableEntry& i_entry, uint32_t i_filename_hash) {
+                                         return i_entry.filename_hash < i_filename_hash;
+                                     });
+    if (entry_it != end && entry_it->filename_hash == filename_hash)
     {
-        return dir_it->second;
+        return entry_it;
     }
+    return nullptr;
+}
+
+const Index::HashTableEntry* Index::find_entry(uint32_t dir_hash, uint32_t filename_hash) const
+{
+    auto dir_entry = find_dir(dir_hash);
+    return dir_entry ? find_entry(*dir_entry, filename_hash) : nullptr;
+}
+
+const Index::DirEntry& Index::get_dir_entry(uint32_t dir_hash) const
+{
+    auto dir_entry = find_dir(dir_hash);
+    if (!dir_entry)
+    {
+        throw std::runtime_error("dir_hash not found");
+    }
+    return *dir_entry;
 }
 const Index::HashTableEntry& Index::get_hash_table_entry(uint32_t dir_hash, uint32_t filename_hash) const
 {
-    auto& dir_hash_table = get_dir_hash_table(dir_hash);
-    auto file_it = dir_hash_table.find(filename_hash);
-    if (file_it == dir_hash_table.end())
+    auto entry = find_entry(get_dir_entry(dir_hash), filename_hash);
+    if (!entry)
     {
         throw std::runtime_error("filename_hash not found");
     }
-    else
+    return *entry;
+}
+
+std::vector<utils::crc32::HashHit> Index::search_dirs(const std::string& i_format, uint32_t i_first_index,
+                                                      const utils::crc32::DigitRange& i_first_range) const
+{
+    return utils::crc32::search_hashes_1(i_format, i_first_index,
+                                         [this](uint32_t i_hash) { return check_dir_existence(i_hash); }, i_first_range);
+}
+std::vector<utils::crc32::HashHit> Index::search_dirs(const std::string& i_format, uint32_t i_first_index, uint32_t i_second_index,
+                                                      utils::thread_pool::ThreadPool* i_pool,
+                                                      const utils::crc32::DigitRange& i_first_range, const utils::crc32::DigitRange& i_second_range) const
+{
+    return utils::crc32::search_hashes_2(i_format, i_first_index, i_second_index,
+                                         [this](uint32_t i_hash) { return check_dir_existence(i_hash); }, i_pool, i_first_range, i_second_range);
+}
+
+std::vector<utils::crc32::HashHit> Index::search_files(const DirEntry& i_dir_entry, const std::string& i_format, uint32_t i_first_index,
+                                                       const utils::crc32::DigitRange& i_first_range) const
+{
+    return utils::crc32::search_hashes_1(i_format, i_first_index,
+                                         [this, &i_dir_entry](uint32_t i_hash) { return find_entry(i_dir_entry, i_hash) != nullptr; }, i_first_range);
+}
+
+void Index::read_hash_table(const IndexBlockRecord& i_hash_table_block_record)
+{
+    // Get the whole hash table in one go, when mapped it is parsed straight from the mapped pages
+    std::vector<char> hash_table_buffer;
+    auto hash_table_data = get_data(i_hash_table_block_record.offset, i_hash_table_block_record.size, hash_table_buffer);
+
+    // The entries are stored little endian, so they can be used as is
+    auto index_hash_table_entries = reinterpret_cast<const IndexHashTableEntry*>(hash_table_data);
+    const uint32_t index_hash_table_entry_count = i_hash_table_block_record.size / sizeof(IndexHashTableEntry);
+
+    XIV_DEBUG(xiv_dat_logger, "Hash table entry count: " << index_hash_table_entry_count);
+
+    // Convert every index_hash_table_entry to a HashTableEntry
+    _entries.resize(index_hash_table_entry_count);
+    for (uint32_t i = 0; i < index_hash_table_entry_count; ++i)
+    {
+        auto& index_hash_table_entry = index_hash_table_entries[i];
+        auto& hash_table_entry = _entries[i];
+        // The dat number is found in the offset, last four bits
+        hash_table_entry.dat_nb = (index_hash_table_entry.dat_offset & 0xF) / 0x2;
+        // The offset in the dat file, needs to strip the dat number indicator
+        hash_table_entry.dat_offset = (index_hash_table_entry.dat_offset & 0xFFFFFFF0) * 0x08;
+        hash_table_entry.dir_hash = index_hash_table_entry.dir_hash;
+        hash_table_entry.filename_hash = index_hash_table_entry.filename_hash;
+    }
+}
+
+bool Index::load_cache(const boost::filesystem::path& i_cache_path, const IndexCacheHeader& i_cache_header)
+{
+    std::ifstream ifs(i_cache_path.string(), std::ios_base::binary | std::ios_base::in);
+    if (!ifs)
+    {
+        return false;
+    }
+
+    // Everything but the table sizes must match
+    IndexCacheHeader file_cache_header;
+    if (!ifs.read(reinterpret_cast<char*>(&file_cache_header), sizeof(file_cache_header)) ||
+        std::memcmp(&file_cache_header, &i_cache_header, offsetof(IndexCacheHeader, entry_count)) != 0)
+    {
+        XIV_INFO(xiv_dat_logger, "Index cache is stale: " << i_cache_path);
+        return false;
+    }
+
+    // The slot count must be a power of 2 with at least one empty slot, find_dir relies on it
+    const uint32_t dir_slot_count = file_cache_header.dir_slot_count;
+    if ((dir_slot_count == 0) || (dir_slot_count & (dir_slot_count - 1)) || (file_cache_header.dir_count >= dir_slot_count))
+    {
+        XIV_WARNING(xiv_dat_logger, "Index cache is invalid: " << i_cache_path);
+        return false;
+    }
+
+    // Straight copies into the tables, nothing to rebuild
+    _entries.resize(file_cache_header.entry_count);
+    _dirs.resize(file_cache_header.dir_count);
+    _dir_slots.resize(dir_slot_count);
+    if (!ifs.read(reinterpret_cast<char*>(_entries.data()), _entries.size() * sizeof(HashTableEntry)) ||
+        !ifs.read(reinterpret_cast<char*>(_dirs.data()), _dirs.size() * sizeof(DirEntry)) ||
+        !ifs.read(reinterpret_cast<char*>(_dir_slots.data()), _dir_slots.size() * sizeof(uint32_t)))
+    {
+        XIV_WARNING(xiv_dat_logger, "Index cache is truncated: " << i_cache_path);
+        _entries.clear();
+        _dirs.clear();
+        _dir_slots.clear();
+        return false;
+    }
+
+    // Cheap sanity check of the ranges so that a corrupted cache cannot lead to reads out of the tables
+    bool is_valid = true;
+    for (auto& dir_entry: _dirs)
+    {
+        is_valid &= (dir_entry.first_entry <= _entries.size()) && (dir_entry.entry_count <= _entries.size() - dir_entry.first_entry);
+    }
+    for (auto dir_slot: _dir_slots)
+    {
+        is_valid &= (dir_slot <= _dirs.size());
+    }
+    if (!is_valid)
+    {
+        XIV_WARNING(xiv_dat_logger, "Index cache is invalid: " << i_cache_path);
+        _entries.clear();
+        _dirs.clear();
+        _dir_slots.clear();
+        return false;
+    }
+
+    XIV_DEBUG(xiv_dat_logger, "Loaded index cache: " << i_cache_path);
+    return true;
+}
+
+void Index::save_cache(const boost::filesystem::path& i_cache_path, const IndexCacheHeader& i_cache_header) const
+{
+    IndexCacheHeader file_cache_header = i_cache_header;
+    file_cache_header.entry_count = _entries.size();
+    file_cache_header.dir_count = _dirs.size();
+    file_cache_header.dir_slot_count = _dir_slots.size();
+
+    // Written to a unique temporary file then renamed, so that a reader never sees a partial cache
+    boost::system::error_code error_code;
+    boost::filesystem::create_directories(i_cache_path.parent_path(), error_code);
+    auto temp_path = i_cache_path.parent_path() / boost::filesystem::unique_path(i_cache_path.filename().string() + ".%%%%-%%%%");
+    {
+        std::ofstream ofs(temp_path.string(), std::ios_base::binary | std::ios_base::out);
+        ofs.write(reinterpret_cast<const char*>(&file_cache_header), sizeof(file_cache_header));
+        ofs.write(reinterpret_cast<const char*>(_entries.data()), _entries.size() * sizeof(HashTableEntry));
+        ofs.write(reinterpret_cast<const char*>(_dirs.data()), _dirs.size() * sizeof(DirEntry));
+        ofs.write(reinterpret_cast<const char*>(_dir_slots.data()), _dir_slots.size() * sizeof(uint32_t));
+        // Closed before checking so that a failed flush is not renamed over the cache
+        ofs.close();
+        if (!ofs)
+        {
+            error_code = boost::system::errc::make_error_code(boost::system::errc::io_error);
+        }
+    }
+    if (!error_code)
+    {
+        boost::filesystem::rename(temp_path, i_cache_path, error_code);
+    }
+
+    // The cache is only an optimization, failing to write it is not an error
+    if (error_code)
+    {
+        XIV_WARNING(xiv_dat_logger, "Could not write index cache: " << i_cache_path << " - " << error_code.message());
+        boost::filesystem::remove(temp_path, error_code);
+    }
+}
+
+std::size_t Index::get_memory_usage() const
+{
+    return _entries.capacity() * sizeof(HashTableEntry) +
+           _dirs.capacity() * sizeof(DirEntry) +
+           _dir_slots.capacity() * sizeof(uint32_t);
+}
+
+void Index::build_dir_table()
+{
+    // Sort so that the files of a dir are contiguous and can be binary searched
+    std::sort(_entries.begin(), _entries.end(),
+              [](const HashTableEntry& i_lhs, const HashTableEntry& i_rhs) {
+                  return (i_lhs.dir_hash != i_rhs.dir_hash) ? (i_lhs.dir_hash < i_rhs.dir_hash) : (i_lhs.filename_hash < i_rhs.filename_hash);
+              });
+
+    // One DirEntry per run of the same dir_hash
+    _dirs.clear();
+    for (uint32_t i = 0; i < _entries.size(); ++i)
+    {
+        if (_dirs.empty() || _dirs.back().dir_hash != _entries[i].dir_hash)
+        {
+            DirEntry dir_entry;
+            dir_entry.dir_hash = _entries[i].dir_hash;
+            dir_entry.first_entry = i;
+            dir_entry.entry_count = 0;
+            _dirs.push_back(dir_entry);
+        }
+        ++_dirs.back().entry_count;
+    }
+
+    // At most half full so that probe sequences stay short, and always one empty slot to end them
+    uint32_t slot_count = 1;
+    while (slot_count < 2 * _dirs.size() + 1)
+    {
+        slot_count *= 2;
+    }
+    _dir_slots.assign(slot_count, 0);
+
+    const uint32_t slot_mask = slot_count - 1;
+    for (uint32_t i = 0; i < _dirs.size(); ++i)
     {
-        return file_it->second;
+        uint32_t slot = _dirs[i].dir_hash & slot_mask;
+        while (_dir_slots[slot] != 0)
+        {
+            slot = (slot + 1) & slot_mask;
+        }
+        _dir_slots[slot] = i + 1;
     }
 }
 
-void Index::is_index_block_valid(const IndexBlockRecord& i_index_block_record)
+void Index::add_index_block(const IndexBlockRecord& i_index_block_record)
 {
-    is_block_valid(i_index_block_record.offset, i_index_block_record.size, i_index_block_record.block_hash);
+    add_hashed_block(i_index_block_record.offset, i_index_block_record.size, i_index_block_record.block_hash);
 }
 
 }
@@ -0,0 +1,22 @@
+#include <xiv/dat/Options.h>
+
+namespace xiv
+{
+namespace dat
+{
+
+Options::Options() :
+    read_mode(ReadMode::positional),
+    verify_blocks(false),
+    open_all_categories(false),
+    decode_pool(nullptr),
+    parallel_decode_min_blocks(8),
+    coalesce_max_gap(64 * 1024),
+    coalesce_max_size(8 * 1024 * 1024),
+    stream_chunk_size(1024 * 1024),
+    file_allocator(nullptr)
+{
+}
+
+}
+}
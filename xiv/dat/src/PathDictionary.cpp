@@ -0,0 +1,262 @@
+#include <xiv/dat/PathDictionary.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+
+#include <xiv/dat/GameData.h>
+#include <xiv/dat/logger.h>
+
+namespace xiv
+{
+namespace dat
+{
+
+// Header of a dictionary file, followed by the entries sorted by hashes then the path strings
+// Like the index cache it is a local artifact, written in native layout and endianness
+struct PathDictionaryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t entry_count;
+    uint32_t strings_size;
+};
+
+struct PathDictionary::Entry
+{
+    uint32_t cat_nb;
+    uint32_t dir_hash;
+    uint32_t filename_hash;
+    // Position of the path in the strings, not null terminated
+    uint32_t path_offset;
+    uint32_t path_size;
+};
+
+namespace
+{
+const char path_dictionary_magic[8] = "XIVPDIC";
+// To bump whenever the layout of the file changes
+const uint32_t path_dictionary_version = 1;
+}
+
+PathDictionary::PathDictionary(const boost::filesystem::path& i_path) :
+    _entries(nullptr),
+    _entry_count(0),
+    _strings(nullptr)
+{
+    _file_mapping = boost::interprocess::file_mapping(i_path.string().c_str(), boost::interprocess::read_only);
+    _mapped_region = boost::interprocess::mapped_region(_file_mapping, boost::interprocess::read_only);
+
+    auto data = static_cast<const char*>(_mapped_region.get_address());
+    const uint64_t size = _mapped_region.get_size();
+
+    PathDictionaryHeader header;
+    if (size < sizeof(header))
+    {
+        throw std::runtime_error("Path dictionary is truncated: " + i_path.string());
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, path_dictionary_magic, sizeof(header.magic)) != 0 ||
+        header.version != path_dictionary_version || header.entry_size != sizeof(Entry))
+    {
+        throw std::runtime_error("Path dictionary is not valid: " + i_path.string());
+    }
+    if (sizeof(header) + uint64_t(header.entry_count) * sizeof(Entry) + header.strings_size > size)
+    {
+        throw std::runtime_error("Path dictionary is truncated: " + i_path.string());
+    }
+
+    _entries = reinterpret_cast<const Entry*>(data + sizeof(header));
+    _entry_count = header.entry_count;
+    _strings = data + sizeof(header) + header.entry_count * sizeof(Entry);
+
+    // Cheap sanity check of the ranges so that a corrupted file cannot lead to reads out of the mapping
+    for (uint32_t i = 0; i < _entry_count; ++i)
+    {
+        if (_entries[i].path_offset > header.strings_size || _entries[i].path_size > header.strings_size - _entries[i].path_offset)
+        {
+            throw std::runtime_error("Path dictionary is not valid: " + i_path.string());
+        }
+    }
+
+    XIV_DEBUG(xiv_dat_logger, "Opened path dictionary: " << i_path << " - " << _entry_count << " paths");
+}
+
+PathDictionary::~PathDictionary()
+{
+}
+
+uint32_t PathDictionary::get_path_count() const
+{
+    return _entry_count;
+}
+
+const PathDictionary::Entry* PathDictionary::lower_bound(uint32_t i_cat_nb, uint32_t i_dir_hash, uint32_t i_filename_hash) const
+{
+    return std::lower_bound(_entries, _entries + _entry_count, std::make_tuple(i_cat_nb, i_dir_hash, i_filename_hash),
+                            [](const Entry& i_entry, const std::tuple<uint32_t, uint32_t, uint32_t>& i_hashes) {
+                                return std::make_tuple(i_entry.cat_nb, i_entry.dir_hash, i_entry.filename_hash) < i_hashes;
+                            });
+}
+
+std::string PathDictionary::get_path(const Entry& i_entry) const
+{
+    return std::string(_strings + i_entry.path_offset, i_entry.path_size);
+}
+
+std::string PathDictionary::find_path(const PathHash& i_path_hash) const
+{
+    auto entry = lower_bound(i_path_hash.get_cat_nb(), i_path_hash.get_dir_hash(), i_path_hash.get_filename_hash());
+    if (entry != _entries + _entry_count && entry->cat_nb == i_path_hash.get_cat_nb() &&
+        entry->dir_hash == i_path_hash.get_dir_hash() && entry->filename_hash == i_path_hash.get_filename_hash())
+    {
+        return get_path(*entry);
+    }
+    return std::string();
+}
+
+std::string PathDictionary::find_dir_path(uint32_t i_cat_nb, uint32_t i_dir_hash) const
+{
+    auto entry = lower_bound(i_cat_nb, i_dir_hash, 0);
+    if (entry != _entries + _entry_count && entry->cat_nb == i_cat_nb && entry->dir_hash == i_dir_hash)
+    {
+        auto path = get_path(*entry);
+        return path.substr(0, path.rfind('/'));
+    }
+    return std::string();
+}
+
+void PathDictionary::for_each_path(const PathCallback& i_callback) const
+{
+    for (uint32_t i = 0; i < _entry_count; ++i)
+    {
+        i_callback(get_path(_entries[i]));
+    }
+}
+
+PathDictionaryBuilder::PathDictionaryBuilder()
+{
+}
+
+PathDictionaryBuilder::~PathDictionaryBuilder()
+{
+}
+
+void PathDictionaryBuilder::add(const std::string& i_path)
+{
+    const PathHash path_hash(i_path);
+
+    KnownPath known_path = { path_hash.get_cat_nb(), path_hash.get_dir_hash(), path_hash.get_filename_hash(), i_path };
+    std::transform(known_path.path.begin(), known_path.path.end(), known_path.path.begin(), path_hash::to_lower);
+
+    std::lock_guard<std::mutex> lock(_paths_mutex);
+    _paths.push_back(std::move(known_path));
+}
+
+bool PathDictionaryBuilder::add_if_exists(GameData& i_game_data, const std::string& i_path)
+{
+    // Cheap rejection of the strings that cannot be paths before hashing them
+    if (i_path.find('/') == std::string::npos)
+    {
+        return false;
+    }
+    // Most of the strings with a / are not paths ("HP/MP"), rejected without throwing
+    PathHash path_hash(0, 0, 0);
+    if (!PathHash::try_parse(i_path, path_hash))
+    {
+        return false;
+    }
+    // Known category but no category file for it
+    auto& cat_nbs = i_game_data.get_cat_nbs();
+    if (std::find(cat_nbs.begin(), cat_nbs.end(), path_hash.get_cat_nb()) == cat_nbs.end())
+    {
+        return false;
+    }
+    if (!i_game_data.check_file_existence(path_hash))
+    {
+        return false;
+    }
+    add(i_path);
+    return true;
+}
+
+void PathDictionaryBuilder::add(const PathDictionary& i_dictionary)
+{
+    i_dictionary.for_each_path([this](const std::string& i_path) {
+        add(i_path);
+    });
+}
+
+uint32_t PathDictionaryBuilder::get_path_count() const
+{
+    std::lock_guard<std::mutex> lock(_paths_mutex);
+    return _paths.size();
+}
+
+void PathDictionaryBuilder::write(const boost::filesystem::path& i_path) const
+{
+    std::vector<const KnownPath*> sorted_paths;
+    {
+        std::lock_guard<std::mutex> lock(_paths_mutex);
+        for (auto& known_path : _paths)
+        {
+            sorted_paths.push_back(&known_path);
+        }
+    }
+
+    // Sorted like the lookups expect, a hash keeps the first path added for it
+    auto hashes = [](const KnownPath* i_path) { return std::make_tuple(i_path->cat_nb, i_path->dir_hash, i_path->filename_hash); };
+    std::stable_sort(sorted_paths.begin(), sorted_paths.end(), [&hashes](const KnownPath* i_lhs, const KnownPath* i_rhs) {
+        return hashes(i_lhs) < hashes(i_rhs);
+    });
+    sorted_paths.erase(std::unique(sorted_paths.begin(), sorted_paths.end(), [&hashes](const KnownPath* i_lhs, const KnownPath* i_rhs) {
+        return hashes(i_lhs) == hashes(i_rhs);
+    }), sorted_paths.end());
+
+    std::vector<PathDictionary::Entry> entries;
+    std::string strings;
+    entries.reserve(sorted_paths.size());
+    for (auto known_path : sorted_paths)
+    {
+        entries.push_back({ known_path->cat_nb, known_path->dir_hash, known_path->filename_hash,
+                            static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(known_path->path.size()) });
+        strings += known_path->path;
+    }
+
+    PathDictionaryHeader header;
+    std::memcpy(header.magic, path_dictionary_magic, sizeof(header.magic));
+    header.version = path_dictionary_version;
+    header.entry_size = sizeof(PathDictionary::Entry);
+    header.entry_count = entries.size();
+    header.strings_size = strings.size();
+
+    // Written to a unique temporary file then renamed, so that a reader never sees a partial dictionary
+    if (!i_path.parent_path().empty())
+    {
+        boost::filesystem::create_directories(i_path.parent_path());
+    }
+    auto temp_path = i_path.parent_path() / boost::filesystem::unique_path(i_path.filename().string() + ".%%%%-%%%%");
+    {
+        std::ofstream ofs(temp_path.string(), std::ios_base::binary | std::ios_base::out);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PathDictionary::Entry));
+        ofs.write(strings.data(), strings.size());
+        // Closed before checking so that a failed flush is not renamed over the dictionary
+        ofs.close();
+        if (!ofs)
+        {
+            boost::system::error_code error_code;
+            boost::filesystem::remove(temp_path, error_code);
+            throw std::runtime_error("Failed to write path dictionary: " + i_path.string());
+        }
+    }
+    boost::filesystem::rename(temp_path, i_path);
+
+    XIV_INFO(xiv_dat_logger, "Wrote path dictionary: " << i_path << " - " << entries.size() << " paths");
+}
+
+}
+}
@@ -0,0 +1,118 @@
+#include <xiv/dat/PathHash.h>
+
+#include <algorithm>
+
+#include <xiv/utils/crc32.h>
+
+namespace
+{
+// A buffer bigger than its content must hash like the literal
+constexpr char root_exl_literal_hash_check[64] = "exd/root.exl";
+static_assert(xiv::dat::PathHash(root_exl_literal_hash_check).get_dir_hash() == xiv::dat::PathHash("exd/root.exl").get_dir_hash() &&
+              xiv::dat::PathHash(root_exl_literal_hash_check).get_filename_hash() == xiv::dat::PathHash("exd/root.exl").get_filename_hash(),
+              "PathHash of a char array must stop at its first null");
+}
+
+namespace xiv
+{
+namespace dat
+{
+
+PathHash::PathHash(const char* i_path, std::size_t i_size)
+{
+    if (!try_parse(i_path, i_size, *this))
+    {
+        // Only on failure, find out why
+        const auto first_slash = std::find(i_path, i_path + i_size, '/');
+        if (first_slash == i_path + i_size)
+        {
+            throw std::runtime_error("Path do not have a / char: " + std::string(i_path, i_size));
+        }
+        throw std::runtime_error("Category not found: " + std::string(i_path, first_slash));
+    }
+}
+
+bool PathHash::try_parse(const char* i_path, std::size_t i_size, PathHash& o_path_hash)
+{
+    // Lowercased copy so the crc kernels can run on whole segments, on the stack for any real path
+    char stack_path[path_stack_size];
+    std::string heap_path;
+    char* lower_path = stack_path;
+    if (i_size > path_stack_size)
+    {
+        heap_path.resize(i_size);
+        lower_path = &heap_path[0];
+    }
+
+    std::size_t first_slash_pos = i_size;
+    std::size_t last_slash_pos = i_size;
+    bool has_slash = false;
+    for (std::size_t i = 0; i < i_size; ++i)
+    {
+        const char c = path_hash::to_lower(i_path[i]);
+        if (c == '/')
+        {
+            if (!has_slash)
+            {
+                first_slash_pos = i;
+                has_slash = true;
+            }
+            last_slash_pos = i;
+        }
+        lower_path[i] = c;
+    }
+    if (!has_slash)
+    {
+        return false;
+    }
+
+    // Category from the part before the first /, compared in place, checked first so that non paths are not hashed
+    for (uint32_t i = 0; i < category_name_count; ++i)
+    {
+        if (path_hash::equals_lower(lower_path, first_slash_pos, category_names[i].name))
+        {
+            o_path_hash._cat_nb = category_names[i].nb;
+            o_path_hash._dir_hash = utils::crc32::update(0xFFFFFFFF, lower_path, last_slash_pos);
+            o_path_hash._filename_hash = utils::crc32::update(0xFFFFFFFF, lower_path + last_slash_pos + 1, i_size - last_slash_pos - 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PathHash::try_parse(const std::string& i_path, PathHash& o_path_hash)
+{
+    return try_parse(i_path.data(), i_path.size(), o_path_hash);
+}
+
+PathHash::PathHash(const std::string& i_path) :
+    PathHash(i_path.data(), i_path.size())
+{
+}
+
+uint32_t get_category_nb(const std::string& i_cat_name)
+{
+    for (uint32_t i = 0; i < category_name_count; ++i)
+    {
+        if (i_cat_name == category_names[i].name)
+        {
+            return category_names[i].nb;
+        }
+    }
+    throw std::runtime_error("Category not found: " + i_cat_name);
+}
+
+std::string get_category_name(uint32_t i_cat_nb)
+{
+    for (uint32_t i = 0; i < category_name_count; ++i)
+    {
+        if (category_names[i].nb == i_cat_nb)
+        {
+            return category_names[i].name;
+        }
+    }
+    return std::string();
+}
+
+}
+}
@@ -0,0 +1,257 @@
+#include <xiv/dat/PathPattern.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <xiv/utils/crc32.h>
+#include <xiv/utils/thread_pool.h>
+
+#include <xiv/dat/PathHash.h>
+#include <xiv/dat/Index.h>
+
+namespace
+{
+// Width of the digit groups, the one of utils::crc32::search_hashes_1/2
+const uint32_t digit_count = 4;
+
+bool is_digits(const std::string& i_string)
+{
+    return !i_string.empty() && std::all_of(i_string.begin(), i_string.end(), [](char i_char) { return i_char >= '0' && i_char <= '9'; });
+}
+}
+
+namespace xiv
+{
+namespace dat
+{
+
+PathPattern::PathPattern(const std::string& i_pattern) :
+    _pattern(i_pattern)
+{
+    const auto first_slash_pos = _pattern.find('/');
+    const auto last_slash_pos = _pattern.rfind('/');
+    if (first_slash_pos == std::string::npos)
+    {
+        throw std::runtime_error("Path pattern do not have a / char: " + _pattern);
+    }
+
+    std::string cat_name = _pattern.substr(0, first_slash_pos);
+    std::transform(cat_name.begin(), cat_name.end(), cat_name.begin(), path_hash::to_lower);
+    _cat_nb = get_category_nb(cat_name);
+
+    parse(_pattern.substr(0, last_slash_pos), _dir_format, _dir_groups, nullptr);
+    if (_dir_groups.size() > 2)
+    {
+        throw std::runtime_error("Too many digit groups in the dir of path pattern, 2 at most: " + _pattern);
+    }
+
+    for (auto& filename_text : expand_alternatives(_pattern.substr(last_slash_pos + 1)))
+    {
+        Filename filename;
+        parse(filename_text, filename.format, filename.groups, &filename.references);
+        if (filename.groups.size() > 1)
+        {
+            throw std::runtime_error("Too many digit groups in the filename of path pattern, 1 at most: " + _pattern);
+        }
+        for (auto& reference : filename.references)
+        {
+            if (reference.group >= _dir_groups.size())
+            {
+                throw std::runtime_error("Path pattern references a group that is not in the dir: " + _pattern);
+            }
+        }
+        _filenames.push_back(std::move(filename));
+    }
+}
+
+const std::string& PathPattern::get_pattern() const
+{
+    return _pattern;
+}
+
+uint32_t PathPattern::get_cat_nb() const
+{
+    return _cat_nb;
+}
+
+std::vector<std::string> PathPattern::expand_alternatives(const std::string& i_text) const
+{
+    std::vector<std::string> texts(1);
+    for (std::size_t pos = 0; pos < i_text.size(); ++pos)
+    {
+        const auto close_pos = (i_text[pos] == '{') ? i_text.find('}', pos) : std::string::npos;
+        const auto content = (close_pos != std::string::npos) ? i_text.substr(pos + 1, close_pos - pos - 1) : std::string();
+        if (content.find('|') == std::string::npos)
+        {
+            // Groups and references are parsed later
+            for (auto& text : texts)
+            {
+                text.push_back(i_text[pos]);
+            }
+            continue;
+        }
+
+        std::vector<std::string> alternatives;
+        for (std::size_t begin = 0, end = 0; end != std::string::npos; begin = end + 1)
+        {
+            end = content.find('|', begin);
+            alternatives.push_back(content.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+        }
+
+        std::vector<std::string> expanded_texts;
+        for (auto& text : texts)
+        {
+            for (auto& alternative : alternatives)
+            {
+                expanded_texts.push_back(text + alternative);
+            }
+        }
+        texts.swap(expanded_texts);
+        pos = close_pos;
+    }
+    return texts;
+}
+
+void PathPattern::parse(const std::string& i_text, std::string& o_format, std::vector<DigitGroup>& o_groups, std::vector<GroupReference>* o_references) const
+{
+    for (std::size_t pos = 0; pos < i_text.size(); ++pos)
+    {
+        const char c = i_text[pos];
+        if (c == '}')
+        {
+            throw std::runtime_error("Unmatched } in path pattern: " + _pattern);
+        }
+        if (c != '{')
+        {
+            o_format.push_back(path_hash::to_lower(c));
+            continue;
+        }
+
+        const auto close_pos = i_text.find('}', pos);
+        if (close_pos == std::string::npos)
+        {
+            throw std::runtime_error("Unmatched { in path pattern: " + _pattern);
+        }
+        const auto content = i_text.substr(pos + 1, close_pos - pos - 1);
+        const uint32_t position = o_format.size();
+
+        const auto dash_pos = content.find('-');
+        if (dash_pos != std::string::npos)
+        {
+            // {xxxx-yyyy}
+            const auto min_digits = content.substr(0, dash_pos);
+            const auto max_digits = content.substr(dash_pos + 1);
+            if (min_digits.size() != digit_count || max_digits.size() != digit_count || !is_digits(min_digits) || !is_digits(max_digits))
+            {
+                throw std::runtime_error("Digit groups must be written {xxxx-yyyy} in path pattern: " + _pattern);
+            }
+            DigitGroup group = { position, static_cast<uint32_t>(std::stoul(min_digits)), static_cast<uint32_t>(std::stoul(max_digits)) };
+            if (group.min_value > group.max_value)
+            {
+                throw std::runtime_error("Empty digit group in path pattern: " + _pattern);
+            }
+            o_groups.push_back(group);
+        }
+        else if (is_digits(content))
+        {
+            // {n}
+            if (!o_references)
+            {
+                throw std::runtime_error("Group references are only allowed in the filename of path pattern: " + _pattern);
+            }
+            const auto group_nb = std::stoul(content);
+            if (group_nb == 0)
+            {
+                throw std::runtime_error("Groups are numbered from 1 in path pattern: " + _pattern);
+            }
+            o_references->push_back({ position, static_cast<uint32_t>(group_nb - 1) });
+        }
+        else
+        {
+            throw std::runtime_error("Invalid {" + content + "} in path pattern: " + _pattern);
+        }
+
+        o_format.append(digit_count, '0');
+        pos = close_pos;
+    }
+}
+
+void PathPattern::write_digits(std::string& io_format, uint32_t i_position, uint32_t i_value)
+{
+    for (uint32_t i = digit_count; i > 0; --i)
+    {
+        io_format[i_position + i - 1] = static_cast<char>('0' + i_value % 10);
+        i_value /= 10;
+    }
+}
+
+utils::crc32::DigitRange PathPattern::get_range(const DigitGroup& i_group)
+{
+    return { i_group.min_value, i_group.max_value };
+}
+
+void PathPattern::search(const Index& i_index, const PathCallback& i_callback, utils::thread_pool::ThreadPool& i_pool) const
+{
+    // Dirs with the values of their groups, only the values in the ranges are hashed
+    std::vector<utils::crc32::HashHit> dir_hits;
+    switch (_dir_groups.size())
+    {
+        case 0:
+        {
+            const auto dir_hash = utils::crc32::compute(_dir_format);
+            if (i_index.check_dir_existence(dir_hash))
+            {
+                dir_hits.push_back({ 0, 0, dir_hash });
+            }
+            break;
+        }
+        case 1:
+            dir_hits = i_index.search_dirs(_dir_format, _dir_groups[0].position, get_range(_dir_groups[0]));
+            break;
+        default:
+            dir_hits = i_index.search_dirs(_dir_format, _dir_groups[0].position, _dir_groups[1].position, &i_pool,
+                                           get_range(_dir_groups[0]), get_range(_dir_groups[1]));
+            break;
+    }
+
+    // Then the filenames, one dir per task
+    i_pool.parallel_for(dir_hits.size(), [&](uint32_t i) {
+        auto& dir_hit = dir_hits[i];
+        const uint32_t values[] = { dir_hit.first_value, dir_hit.second_value };
+
+        auto dir = _dir_format;
+        for (uint32_t g = 0; g < _dir_groups.size(); ++g)
+        {
+            write_digits(dir, _dir_groups[g].position, values[g]);
+        }
+        auto& dir_entry = i_index.get_dir_entry(dir_hit.hash);
+
+        for (auto& filename_plan : _filenames)
+        {
+            auto filename = filename_plan.format;
+            for (auto& reference : filename_plan.references)
+            {
+                write_digits(filename, reference.position, values[reference.group]);
+            }
+
+            if (filename_plan.groups.empty())
+            {
+                if (i_index.find_entry(dir_entry, utils::crc32::compute(filename)))
+                {
+                    i_callback(dir + "/" + filename);
+                }
+                continue;
+            }
+
+            auto& group = filename_plan.groups.front();
+            for (auto& file_hit : i_index.search_files(dir_entry, filename, group.position, get_range(group)))
+            {
+                write_digits(filename, group.position, file_hit.first_value);
+                i_callback(dir + "/" + filename);
+            }
+        }
+    });
+}
+
+}
+}
@@ -1,5 +1,16 @@
 #include <xiv/dat/SqPack.h>
 
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
 #include <xiv/dat/logger.h>
 
 XIV_STRUCT((xiv)(dat), SqPackHeader,
@@ -13,34 +24,223 @@ XIV_STRUCT((xiv)(dat), SqPackIndexHeader,
            XIV_MEM(uint32_t, size)
            XIV_MEM(uint32_t, type));
 
-using xiv::utils::bparse::extract;
-
 namespace xiv
 {
 namespace dat
 {
 
-SqPack::SqPack(const boost::filesystem::path& i_path) :
-    // Open the file
-    _handle(i_path.string(), std::ios_base::in | std::ios_base::binary)
+SqPack::SqPack(const boost::filesystem::path& i_path, ReadMode i_read_mode) :
+    _path(i_path),
+    _read_mode(i_read_mode)
 {
-    XIV_DEBUG(xiv_dat_logger, "Initializing SqPack with path: " << i_path);
+    XIV_DEBUG(xiv_dat_logger, "Initializing SqPack with path: " << i_path << " - read_mode: " << i_read_mode);
+
+#ifdef _WIN32
+    _handle = INVALID_HANDLE_VALUE;
+#else
+    _handle = -1;
+#endif
+
+    if (_read_mode == ReadMode::mapped)
+    {
+        // Map the whole file read only, the OS pages it in on demand and keeps it in its cache
+        _file_mapping = boost::interprocess::file_mapping(i_path.string().c_str(), boost::interprocess::read_only);
+        _mapped_region = boost::interprocess::mapped_region(_file_mapping, boost::interprocess::read_only);
+    }
+    else
+    {
+        // Open the file, read only and shared so that it can be read concurrently
+#ifdef _WIN32
+        // Overlapped so that concurrent ReadFile calls on this handle are not serialized by the system
+        _handle = CreateFileW(i_path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+        if (_handle == INVALID_HANDLE_VALUE)
+#else
+        _handle = ::open(i_path.string().c_str(), O_RDONLY);
+        if (_handle == -1)
+#endif
+        {
+            throw std::runtime_error("Could not open sqpack file: " + i_path.string());
+        }
+    }
 
-    // Extract the header
-    extract<xiv_dat_logger, SqPackHeader>(_handle);
+    // The destructor does not run if the constructor throws, so the handle is closed here on a truncated/invalid file
+    try
+    {
+        // Extract the header
+        extract_at<SqPackHeader>(0);
 
-    // Skip until the IndexHeader the extract it
-    _handle.seekg(0x400);
-    extract<xiv_dat_logger, SqPackIndexHeader>(_handle);
+        // Skip until the IndexHeader the extract it
+        extract_at<SqPackIndexHeader>(0x400);
+        _sub_header_offset = 0x400 + sizeof(SqPackIndexHeader);
+
+        // Both headers are 0x400 bytes, at 0x3C0 is the hash of their first 0x3C0 bytes
+        add_hashed_block(0, 0x3C0, extract_at<SqPackBlockHash>(0x3C0));
+        add_hashed_block(0x400, 0x3C0, extract_at<SqPackBlockHash>(0x7C0));
+    }
+    catch (...)
+    {
+        close_handle();
+        throw;
+    }
 }
 
 SqPack::~SqPack()
 {
+    close_handle();
+}
+
+void SqPack::close_handle()
+{
+#ifdef _WIN32
+    if (_handle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(_handle);
+        _handle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (_handle != -1)
+    {
+        ::close(_handle);
+        _handle = -1;
+    }
+#endif
+}
+
+ReadMode SqPack::get_read_mode() const
+{
+    return _read_mode;
+}
+
+const boost::filesystem::path& SqPack::get_path() const
+{
+    return _path;
+}
+
+const std::vector<SqPack::HashedBlock>& SqPack::get_hashed_blocks() const
+{
+    return _hashed_blocks;
+}
+
+void SqPack::add_hashed_block(uint32_t i_offset, uint32_t i_size, const SqPackBlockHash& i_block_hash)
+{
+    HashedBlock hashed_block;
+    hashed_block.offset = i_offset;
+    hashed_block.size = i_size;
+    std::copy(i_block_hash.hash, i_block_hash.hash + utils::sha1::digest_size, hashed_block.hash.begin());
+
+    if (std::all_of(hashed_block.hash.begin(), hashed_block.hash.end(), [](uint8_t i_byte) { return i_byte == 0; }))
+    {
+        XIV_DEBUG(xiv_dat_logger, "Block without hash - offset: " << i_offset << " - size: " << i_size);
+        return;
+    }
+    _hashed_blocks.push_back(hashed_block);
+}
+
+bool SqPack::is_block_valid(const HashedBlock& i_hashed_block, uint32_t i_chunk_size) const
+{
+    const uint32_t chunk_size = std::max<uint32_t>(i_chunk_size, 1);
+
+    // Read and hashed in turn: the blocks are checked in parallel (see GameData::verify), which keeps the disk busy
+    std::vector<char> chunk_buffer;
+    utils::sha1::Sha1 sha1;
+    uint32_t offset = 0;
+    while (offset < i_hashed_block.size)
+    {
+        const uint32_t size = std::min(chunk_size, i_hashed_block.size - offset);
+        sha1.update(get_data(i_hashed_block.offset + offset, size, chunk_buffer), size);
+        offset += size;
+    }
+    return sha1.finalize() == i_hashed_block.hash;
+}
+
+void SqPack::check_hashed_blocks() const
+{
+    for (auto& hashed_block : _hashed_blocks)
+    {
+        if (!is_block_valid(hashed_block))
+        {
+            throw std::runtime_error("Invalid block in sqpack file: " + _path.string() +
+                                     " - offset: " + std::to_string(hashed_block.offset) + " - size: " + std::to_string(hashed_block.size));
+        }
+    }
+}
+
+void SqPack::read(uint32_t i_offset, uint32_t i_size, char* o_data) const
+{
+    if (_read_mode == ReadMode::mapped)
+    {
+        std::memcpy(o_data, get_mapped_data(i_offset, i_size), i_size);
+        return;
+    }
+
+    // Loop as a single call is allowed to return less than what was asked
+    while (i_size > 0)
+    {
+#ifdef _WIN32
+        // Each read has its own event to wait on, the handle itself is signaled by any completed read
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = i_offset;
+        overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!overlapped.hEvent)
+        {
+            throw std::runtime_error("Error at CreateEvent - offset: " + std::to_string(i_offset) + " - error: " + std::to_string(GetLastError()));
+        }
+
+        DWORD read_size = 0;
+        BOOL success = ReadFile(_handle, o_data, i_size, nullptr, &overlapped);
+        if (success || GetLastError() == ERROR_IO_PENDING)
+        {
+            success = GetOverlappedResult(_handle, &overlapped, &read_size, TRUE);
+        }
+        // Kept before CloseHandle, which overwrites it
+        const DWORD error = success ? ERROR_HANDLE_EOF : GetLastError();
+        CloseHandle(overlapped.hEvent);
+
+        if (!success || read_size == 0)
+        {
+            throw std::runtime_error("Error at ReadFile - offset: " + std::to_string(i_offset) + " - error: " + std::to_string(error));
+        }
+#else
+        auto read_size = ::pread(_handle, o_data, i_size, i_offset);
+        if (read_size == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (read_size == 0)
+        {
+            throw std::runtime_error("Unexpected end of file at pread - offset: " + std::to_string(i_offset));
+        }
+        if (read_size == -1)
+        {
+            throw std::runtime_error("Error at pread - offset: " + std::to_string(i_offset) + " - errno: " + std::to_string(errno));
+        }
+#endif
+        i_offset += read_size;
+        i_size -= read_size;
+        o_data += read_size;
+    }
+}
+
+const char* SqPack::get_data(uint32_t i_offset, uint32_t i_size, std::vector<char>& io_buffer) const
+{
+    if (_read_mode == ReadMode::mapped)
+    {
+        return get_mapped_data(i_offset, i_size);
+    }
+
+    io_buffer.resize(i_size);
+    read(i_offset, i_size, io_buffer.data());
+    return io_buffer.data();
 }
 
-void SqPack::is_block_valid(uint32_t i_offset, uint32_t i_size, const SqPackBlockHash& i_block_hash)
+const char* SqPack::get_mapped_data(uint32_t i_offset, uint32_t i_size) const
 {
-    // TODO
+    if (uint64_t(i_offset) + i_size > _mapped_region.get_size())
+    {
+        throw std::runtime_error("Out of bounds access in mapping - offset: " + std::to_string(i_offset) + " - size: " + std::to_string(i_size));
+    }
+    return static_cast<const char*>(_mapped_region.get_address()) + i_offset;
 }
 
 }
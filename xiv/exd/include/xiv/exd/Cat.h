@@ -3,6 +3,9 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <atomic>
+#include <mutex>
 #include <unordered_map>
 
 #include <boost/filesystem.hpp>
@@ -35,8 +38,11 @@ class Cat
 {
 public:
     // i_name: name of the category
-    // i_game_data: used to fetch the files needed
-    Cat(dat::GameData& i_game_data, const std::string& i_name);
+    // i_game_data: used to fetch the files needed, it must outlive the category
+    // i_decode_all: see Exd, the rows are read on access otherwise
+    // i_languages: the languages that can be loaded, empty for all of them
+    Cat(dat::GameData& i_game_data, const std::string& i_name, bool i_decode_all = false,
+        const std::vector<Language>& i_languages = std::vector<Language>());
     ~Cat();
 
     // Returns the name of the category
@@ -45,20 +51,48 @@ public:
     // Returns the header
     const Exh& get_header() const;
 
-    // Returns data for a specific language
+    // Returns the languages with data: the ones of the header that are in the data files and were not excluded
+    const std::vector<Language>& get_languages() const;
+
+    // Returns data for a specific language, its files are loaded on the first call for it
+    // Thread-safe: concurrent first calls for a language load it once
     const Exd& get_data_ln(Language i_language = Language::none) const;
 
     // Export in csv in base flder i_ouput_path
+    // The languages not loaded yet are loaded one at a time and released once written, they are not kept by the category
     void export_as_csvs(const boost::filesystem::path& i_output_path) const;
 
 protected:
+    // The data of a language and what is needed to load it once
+    struct LanguageSlot
+    {
+        LanguageSlot();
+
+        // Published once the data is fully loaded, so that a lookup is a single load
+        std::atomic<const Exd*> exd;
+        // Owns the data, only touched under creation_mutex
+        std::unique_ptr<Exd> owned_exd;
+        // Prevents two threads from loading the same language
+        std::mutex creation_mutex;
+    };
+
+    // Loads the data of a language, returns it whether it was loaded by this call or not
+    const Exd& create_data_ln(Language i_language, LanguageSlot& io_slot) const;
+    // Reads the files of a language into a new Exd, not stored in its slot
+    std::unique_ptr<Exd> load_data_ln(Language i_language) const;
+
     const std::string _name;
 
+    dat::GameData& _game_data;
+    const bool _decode_all;
+
     // The header file of the category *.exh
     std::unique_ptr<Exh> _header;
-    // The data files of the category, indexed by language *.exd
+
+    std::vector<Language> _languages;
+    // The data files of the category, indexed by language *.exd, the map itself is only written by the constructor
     // Note that if we have multiple files for different range of IDs, they are merged here
-    std::unordered_map<Language, std::unique_ptr<Exd>> _data;
+    std::unordered_map<Language, std::unique_ptr<LanguageSlot>> _data;
 };
 
 }
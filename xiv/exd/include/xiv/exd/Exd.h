@@ -2,19 +2,19 @@
 #define XIV_EXD_EXD_H
 
 #include <memory>
-#include <map>
+#include <vector>
 
 #include <boost/variant.hpp>
 
 #include <xiv/dat/File.h>
 
+#include <xiv/exd/Exh.h>
+
 namespace xiv
 {
 namespace exd
 {
 
-class Exh;
-
 // Field type containing all the possible types in the data files
 typedef boost::variant<
 std::string,
@@ -28,27 +28,103 @@ std::string,
     float,
     uint64_t> Field;
 
+class Exd;
+
+// A row of an Exd, only a view on its columns: it is valid as long as the Exd
+class ExdRow
+{
+public:
+    ExdRow(const Exd& i_exd, uint32_t i_row);
+
+    uint32_t get_id() const;
+
+    // The fields are in the same order as exh.members
+    uint32_t get_field_count() const;
+    // Returns a copy of a field
+    Field get_field(uint32_t i_field) const;
+    // Returns a string field without any copy, null terminated, throws if the field is not a string
+    const char* get_cstring(uint32_t i_field) const;
+
+protected:
+    const Exd* _exd;
+    uint32_t _row;
+};
+
 // Data for a given language
+// Only the record indices are read at load, the fields of a row are read from the raw pages when they are accessed
+// Decoded, the rows are stored by columns: one dense array per member of the exh, the booleans as bits and the strings as offsets in a single buffer
 class Exd
 {
 public:
     // i_exh: the header
-    // i_files: the multiple exd files
-    Exd(const Exh& i_exh, const std::vector<std::unique_ptr<dat::File>>& i_files);
+    // i_files: the multiple exd files, kept as the raw pages of the rows
+    // i_decode_all: decodes all the rows into columns right away then releases the pages, for the callers that scan whole sheets
+    Exd(const Exh& i_exh, std::vector<std::unique_ptr<dat::File>> i_files, bool i_decode_all = false);
     ~Exd();
 
-    // Get a row by its id
-    const std::vector<Field>& get_row(uint32_t id);
+    uint32_t get_row_count() const;
+    uint32_t get_field_count() const;
+    DataType get_field_type(uint32_t i_field) const;
 
-    // Get all rows
-    const std::map<uint32_t, std::vector<Field>>& get_rows();
+    // Whether the rows were decoded into columns
+    bool is_decoded() const;
+
+    // Get a row by its id, throws if it is not there
+    ExdRow get_row(uint32_t id) const;
+    // Get a row by its position, the rows are sorted by id
+    ExdRow get_row_at(uint32_t i_row) const;
+
+    // Get all rows, sorted by id
+    std::vector<ExdRow> get_rows() const;
 
     // Get as csv
     void get_as_csv(std::ostream& o_stream) const;
 
+    // Returns the bytes allocated for the rows, the raw pages included
+    std::size_t get_memory_usage() const;
+
 protected:
-    // Data indexed by the ID of the row, the vector is field with the same order as exh.members
-    std::map<uint32_t, std::vector<Field>> _data;
+    friend class ExdRow;
+
+    // Where a row is in the pages
+    struct Record
+    {
+        uint32_t id;
+        uint32_t page;
+        uint32_t offset;
+    };
+
+    // The values of a member for all the rows, in the order of _records
+    struct Column
+    {
+        DataType type;
+        // Native endian values, one bit per row for the booleans, an offset in _strings for the strings
+        std::vector<uint8_t> values;
+    };
+
+    // Reads all the rows into _columns/_strings then releases the pages
+    void decode_columns();
+
+    // Reads a value from the page of the row
+    template <typename T>
+    T read_value(uint32_t i_row, uint32_t i_field) const;
+
+    Field get_field(uint32_t i_row, uint32_t i_field) const;
+    const char* get_cstring(uint32_t i_row, uint32_t i_field) const;
+
+    // Raw exd files, released once decoded
+    std::vector<std::unique_ptr<dat::File>> _pages;
+    // The rows, sorted by id
+    std::vector<Record> _records;
+    // The members in the order of the fields
+    std::vector<ExhMember> _members;
+    uint32_t _data_offset;
+
+    // Only filled once decoded
+    bool _is_decoded;
+    std::vector<Column> _columns;
+    // All the strings, null terminated, the empty ones all point to the first byte
+    std::vector<char> _strings;
 };
 
 }
@@ -1,14 +1,25 @@
 #ifndef XIV_EXD_EXDDATA_H
 #define XIV_EXD_EXDDATA_H
 
+#include <cstdint>
 #include <unordered_map>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
 
 #include <boost/filesystem.hpp>
 
 namespace xiv
 {
+namespace utils
+{
+namespace thread_pool
+{
+class ThreadPool;
+}
+}
 namespace dat
 {
 class GameData;
@@ -17,6 +28,7 @@ namespace exd
 {
 
 class Cat;
+enum class Language: uint16_t;
 
 // Interface for retrieval of exd data - Main entry point
 // the game_data object should outlive the exd_data object
@@ -24,31 +36,58 @@ class ExdData
 {
 public:
     // Need an initialized dat::GameData to retrieve the files from the dat
-    ExdData(dat::GameData& i_game_data);
+    // i_decode_all: decodes the rows of a sheet when its language is loaded instead of on access, see Exd
+    // i_languages: only these languages can be loaded, e.g. a single locale, empty for all of them
+    ExdData(dat::GameData& i_game_data, bool i_decode_all = false, const std::vector<Language>& i_languages = std::vector<Language>());
     ~ExdData();
 
     // Get the list of thenames of the categories
     const std::vector<std::string>& get_cat_names() const;
 
     // Get a category by its name
+    // Thread-safe: concurrent first calls for a category create it once
     const Cat& get_category(const std::string& i_cat_name);
 
+    // Creates all the categories and loads all their languages in parallel, e.g. to warm up before serving
+    // Runs on i_pool if set, on a temporary pool otherwise
+    void load_all(utils::thread_pool::ThreadPool* i_pool = nullptr);
+
     // Export in csv in base flder i_ouput_path
-    void export_as_csvs(const boost::filesystem::path& i_output_path);
+    // The sheets are loaded and written in parallel, one per worker: the ones not created yet are only kept while they are written
+    // Runs on i_pool if set, on a temporary pool otherwise
+    void export_as_csvs(const boost::filesystem::path& i_output_path, utils::thread_pool::ThreadPool* i_pool = nullptr);
 
 protected:
-    // Lazy instantiation of category
-    void create_category(const std::string& i_cat_name);
+    // A category and what is needed to create it once
+    struct CategorySlot
+    {
+        CategorySlot();
+
+        // Published once the category is fully created, so that a lookup is a single load
+        std::atomic<const Cat*> cat;
+        // Owns the category, only touched under creation_mutex
+        std::unique_ptr<Cat> owned_cat;
+        // Prevents two threads from instantiating the same category
+        std::mutex creation_mutex;
+    };
+
+    // Lazy instantiation of category, returns it whether it was created by this call or not
+    const Cat& create_category(const std::string& i_cat_name, CategorySlot& io_slot);
+
+    // Returns the slot of a category, throws if there is none
+    CategorySlot& get_category_slot(const std::string& i_cat_name);
 
     // Reference to the game_data object
     dat::GameData& _game_data;
 
-    // Categories, indexed by their name
-    std::unordered_map<std::string, std::unique_ptr<Cat>> _cats;
+    // Given to every category
+    const bool _decode_all;
+    const std::vector<Language> _languages;
+
+    // Categories, indexed by their name, the map itself is only written by the constructor
+    std::unordered_map<std::string, std::unique_ptr<CategorySlot>> _cats;
     // List of category names = _cats.keys()
     std::vector<std::string> _cat_names;
-    // Mutexes used to avoid race condition when lazy instantiating a category
-    std::unordered_map<std::string, std::unique_ptr<std::mutex>> _cat_creation_mutexes;
 };
 
 }
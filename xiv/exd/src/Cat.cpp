@@ -1,5 +1,7 @@
 #include <xiv/exd/Cat.h>
 
+#include <algorithm>
+
 #include <boost/assign/list_of.hpp>
 
 #include <xiv/dat/GameData.h>
@@ -25,8 +27,10 @@ namespace xiv
 namespace exd
 {
 
-Cat::Cat(dat::GameData& i_game_data, const std::string& i_name) :
-    _name(i_name)
+Cat::Cat(dat::GameData& i_game_data, const std::string& i_name, bool i_decode_all, const std::vector<Language>& i_languages) :
+    _name(i_name),
+    _game_data(i_game_data),
+    _decode_all(i_decode_all)
 {
     XIV_INFO(xiv_exd_logger, "Initializing Cat with name: " << i_name);
 
@@ -36,23 +40,51 @@ Cat::Cat(dat::GameData& i_game_data, const std::string& i_name) :
         _header = std::unique_ptr<Exh>(new Exh(*header_file));
     }
 
+    // Only the slots here, the files of a language are fetched on its first get_data_ln
     for(auto language: _header->get_languages())
     {
         // chs not yet in data files
-        if (language != Language::chs)
+        if (language != Language::chs &&
+            (i_languages.empty() || std::find(i_languages.begin(), i_languages.end(), language) != i_languages.end()))
         {
-            // Get all the files for a given category/language, in case of multiple range of IDs in separate files (like Quest)
-            std::vector<std::unique_ptr<dat::File>> files;
-            for(auto& exd_def: _header->get_exd_defs())
-            {
-                files.emplace_back(i_game_data.get_file("exd/" + i_name + "_" + std::to_string(exd_def.start_id) + language_map.at(language) + ".exd"));
-            }
-            // Instantiate the data for this language
-            _data[language] = std::unique_ptr<Exd>(new Exd(*_header, files));
+            _languages.push_back(language);
+            _data[language] = std::unique_ptr<LanguageSlot>(new LanguageSlot());
         }
     }
 }
 
+Cat::LanguageSlot::LanguageSlot() :
+    exd(nullptr)
+{
+}
+
+const Exd& Cat::create_data_ln(Language i_language, LanguageSlot& io_slot) const
+{
+    std::lock_guard<std::mutex> lock(io_slot.creation_mutex);
+    // Maybe after unlocking it has already been created, so check (most likely if it blocked)
+    if (!io_slot.owned_exd)
+    {
+        io_slot.owned_exd = load_data_ln(i_language);
+        io_slot.exd.store(io_slot.owned_exd.get(), std::memory_order_release);
+    }
+    return *io_slot.owned_exd;
+}
+
+std::unique_ptr<Exd> Cat::load_data_ln(Language i_language) const
+{
+    XIV_DEBUG(xiv_exd_logger, "Loading Cat: " << _name << " - language: " << i_language);
+
+    // Get all the files in one batch, in case of multiple range of IDs in separate files (like Quest)
+    // They are usually stored next to each other, so they are mostly read together
+    std::vector<std::string> paths;
+    for(auto& exd_def: _header->get_exd_defs())
+    {
+        paths.push_back("exd/" + _name + "_" + std::to_string(exd_def.start_id) + language_map.at(i_language) + ".exd");
+    }
+
+    return std::unique_ptr<Exd>(new Exd(*_header, _game_data.get_files(paths), _decode_all));
+}
+
 Cat::~Cat()
 {
 
@@ -68,6 +100,11 @@ const Exh& Cat::get_header() const
     return *_header;
 }
 
+const std::vector<Language>& Cat::get_languages() const
+{
+    return _languages;
+}
+
 const Exd& Cat::get_data_ln(Language i_language) const
 {
     auto ln_it = _data.find(i_language);
@@ -76,23 +113,33 @@ const Exd& Cat::get_data_ln(Language i_language) const
         throw std::runtime_error("No data for language: " + std::to_string(uint16_t(i_language)));
     }
 
-    return *(ln_it->second);
+    // Fast path: already loaded
+    if (auto exd = ln_it->second->exd.load(std::memory_order_acquire))
+    {
+        return *exd;
+    }
+    return create_data_ln(i_language, *ln_it->second);
 }
 
 void Cat::export_as_csvs(const boost::filesystem::path& i_output_path) const
 {
-    for (auto language: get_header().get_languages())
+    for (auto language: get_languages())
     {
-        if (language != Language::chs)
-        {
-            auto output_file_path = i_output_path / (_name + language_map.at(language) + ".txt");
+        auto output_file_path = i_output_path / (_name + language_map.at(language) + ".txt");
 
-            boost::filesystem::create_directories(output_file_path.parent_path());
+        boost::filesystem::create_directories(output_file_path.parent_path());
 
-            std::ofstream ofs(output_file_path.string());
-            get_data_ln(language).get_as_csv(ofs);
-            ofs.close();
+        std::ofstream ofs(output_file_path.string());
+        if (auto exd = _data.at(language)->exd.load(std::memory_order_acquire))
+        {
+            exd->get_as_csv(ofs);
+        }
+        else
+        {
+            // Not kept in the slot: only one language is in memory at a time
+            load_data_ln(language)->get_as_csv(ofs);
         }
+        ofs.close();
     }
 }
 
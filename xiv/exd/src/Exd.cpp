@@ -1,16 +1,21 @@
 #include <xiv/exd/exd.h>
 
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XIV_EXD_SSE2
+#include <emmintrin.h>
+#endif
+
 #include <boost/bind.hpp>
 #include <boost/io/ios_state.hpp>
 
 #include <xiv/utils/bparse.h>
-#include <xiv/utils/stream.h>
 
 #include <xiv/exd/logger.h>
 #include <xiv/exd/Exh.h>
 
-using xiv::utils::bparse::extract;
-
 XIV_STRUCT((xiv)(exd), ExdHeader,
            XIV_MEM_ARR(char, magic, 0x4)
            XIV_MEM_BE(uint16_t, unknown)
@@ -21,123 +26,507 @@ XIV_STRUCT((xiv)(exd), ExdRecordIndex,
            XIV_MEM_BE(uint32_t, id)
            XIV_MEM_BE(uint32_t, offset));
 
+namespace
+{
+
+// Position of the first null in [i_begin, i_end), i_end if there is none
+const char* find_null(const char* i_begin, const char* i_end)
+{
+#ifdef XIV_EXD_SSE2
+    // 16 bytes at a time while they are all in range, the rest byte by byte
+    const __m128i zero = _mm_setzero_si128();
+    for (; i_end - i_begin >= 16; i_begin += 16)
+    {
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(i_begin)), zero));
+        if (mask != 0)
+        {
+            uint32_t index = 0;
+            while (!(mask & (1 << index)))
+            {
+                ++index;
+            }
+            return i_begin + index;
+        }
+    }
+    for (; i_begin != i_end && *i_begin != '\0'; ++i_begin)
+    {
+    }
+    return i_begin;
+#else
+    auto null_ptr = static_cast<const char*>(std::memchr(i_begin, 0, i_end - i_begin));
+    return null_ptr ? null_ptr : i_end;
+#endif
+}
+
+// Reads the big endian values of an exd straight from its data section, every access is checked against the end of the section
+class ExdReader
+{
+public:
+    ExdReader(const char* i_data, std::size_t i_size) :
+        _data(i_data),
+        _size(i_size)
+    {
+    }
+
+    template <typename T>
+    T read(uint64_t i_offset) const
+    {
+        T value;
+        std::memcpy(&value, get_data(i_offset, sizeof(T)), sizeof(T));
+        return xiv::utils::bparse::byteswap(value);
+    }
+
+    template <typename StructType>
+    StructType read_struct(uint64_t i_offset) const
+    {
+        StructType value;
+        std::memcpy(&value, get_data(i_offset, sizeof(StructType)), sizeof(StructType));
+        xiv::utils::bparse::reorder(value);
+        return value;
+    }
+
+    // Null terminated string, up to the end of the section if the null is missing
+    // Returns its start, o_end is set to the null
+    const char* read_cstring(uint64_t i_offset, const char*& o_end) const
+    {
+        auto begin = get_data(i_offset, 0);
+        o_end = find_null(begin, _data + _size);
+        return begin;
+    }
+
+protected:
+    const char* get_data(uint64_t i_offset, std::size_t i_size) const
+    {
+        if (i_offset > _size || i_size > _size - i_offset)
+        {
+            throw std::runtime_error("Out of bounds access in exd - offset: " + std::to_string(i_offset) + " - size: " + std::to_string(i_size));
+        }
+        return _data + i_offset;
+    }
+
+    const char* _data;
+    std::size_t _size;
+};
+
+// Single bytes do not need a swap
+template <>
+bool ExdReader::read<bool>(uint64_t i_offset) const
+{
+    return *get_data(i_offset, 1) != 0;
+}
+
+template <>
+int8_t ExdReader::read<int8_t>(uint64_t i_offset) const
+{
+    return static_cast<int8_t>(*get_data(i_offset, 1));
+}
+
+template <>
+uint8_t ExdReader::read<uint8_t>(uint64_t i_offset) const
+{
+    return static_cast<uint8_t>(*get_data(i_offset, 1));
+}
+
+// Size of a value in its column, booleans are bits and strings are offsets in the string buffer
+std::size_t get_value_size(xiv::exd::DataType i_type)
+{
+    switch (i_type)
+    {
+    case xiv::exd::DataType::string:
+    case xiv::exd::DataType::int32:
+    case xiv::exd::DataType::uint32:
+    case xiv::exd::DataType::float32:
+        return 4;
+
+    case xiv::exd::DataType::int8:
+    case xiv::exd::DataType::uint8:
+        return 1;
+
+    case xiv::exd::DataType::int16:
+    case xiv::exd::DataType::uint16:
+        return 2;
+
+    case xiv::exd::DataType::uint64:
+        return 8;
+
+    default:
+        throw std::runtime_error("Unknown DataType: " + std::to_string(static_cast<uint16_t>(i_type)));
+    }
+}
+
+template <typename T>
+void store_value(std::vector<uint8_t>& io_values, uint32_t i_row, T i_value)
+{
+    std::memcpy(io_values.data() + i_row * sizeof(T), &i_value, sizeof(T));
+}
+
+template <typename T>
+T load_value(const std::vector<uint8_t>& i_values, uint32_t i_row)
+{
+    T value;
+    std::memcpy(&value, i_values.data() + i_row * sizeof(T), sizeof(T));
+    return value;
+}
+
+ExdReader get_reader(const xiv::dat::File& i_page)
+{
+    auto& data_section = i_page.get_data_sections().front();
+    return ExdReader(data_section.data(), data_section.size());
+}
+
+}
+
 namespace xiv
 {
 namespace exd
 {
 
-Exd::Exd(const Exh& i_exh, const std::vector<std::unique_ptr<dat::File>>& i_files)
+ExdRow::ExdRow(const Exd& i_exd, uint32_t i_row) :
+    _exd(&i_exd),
+    _row(i_row)
+{
+}
+
+uint32_t ExdRow::get_id() const
+{
+    return _exd->_records[_row].id;
+}
+
+uint32_t ExdRow::get_field_count() const
+{
+    return _exd->get_field_count();
+}
+
+Field ExdRow::get_field(uint32_t i_field) const
+{
+    return _exd->get_field(_row, i_field);
+}
+
+const char* ExdRow::get_cstring(uint32_t i_field) const
 {
-    // Iterates over all the files
-    const uint32_t member_count = i_exh.get_members().size();
-    for (auto& file_ptr: i_files)
+    return _exd->get_cstring(_row, i_field);
+}
+
+Exd::Exd(const Exh& i_exh, std::vector<std::unique_ptr<dat::File>> i_files, bool i_decode_all) :
+    _pages(std::move(i_files)),
+    _data_offset(i_exh.get_header().data_offset),
+    _is_decoded(false)
+{
+    // The members in the order of the fields, taken out of the map once for all the rows
+    _members.reserve(i_exh.get_members().size());
+    for (auto& member_entry: i_exh.get_members())
+    {
+        _members.push_back(member_entry.second);
+    }
+
+    // Only the record indices are read here, the rows are read from the pages when they are accessed
+    for (uint32_t i = 0; i < _pages.size(); ++i)
     {
-        // Get a stream
-        auto stream_ptr = utils::stream::get_istream(file_ptr->get_data_sections().front());
-        auto& stream = *stream_ptr;
+        auto reader = get_reader(*_pages[i]);
 
-        // Extract the header and skip to the record indices
-        auto exd_header = extract<xiv_exd_logger, ExdHeader>(stream);
-        stream.seekg(0x20);
+        // Extract the header, the record indices are at 0x20
+        auto exd_header = reader.read_struct<ExdHeader>(0);
+        XIV_DEBUG(xiv_exd_logger, "Extracted: " << exd_header);
 
-        // Preallocate and extract the record_indices
         const uint32_t record_count = exd_header.index_size / sizeof(ExdRecordIndex);
-        std::vector<ExdRecordIndex> record_indices;
-        record_indices.reserve(record_count);
-        for (uint32_t i = 0; i < record_count; ++i)
+        for (uint32_t j = 0; j < record_count; ++j)
         {
-            record_indices.emplace_back(extract<xiv_exd_logger, ExdRecordIndex>(stream, utils::log::Severity::trace));
+            auto record_index = reader.read_struct<ExdRecordIndex>(0x20 + j * sizeof(ExdRecordIndex));
+            _records.push_back({ record_index.id, i, record_index.offset });
         }
+    }
+    std::stable_sort(_records.begin(), _records.end(), [](const Record& i_lhs, const Record& i_rhs) {
+        return i_lhs.id < i_rhs.id;
+    });
+    // An id in several files keeps its first record
+    _records.erase(std::unique(_records.begin(), _records.end(), [](const Record& i_lhs, const Record& i_rhs) {
+        return i_lhs.id == i_rhs.id;
+    }), _records.end());
+    _records.shrink_to_fit();
+
+    if (i_decode_all)
+    {
+        decode_columns();
+    }
+}
+
+template <typename T>
+T Exd::read_value(uint32_t i_row, uint32_t i_field) const
+{
+    // 6 is because we have uint32_t/uint16_t at the start of each record
+    auto& record = _records[i_row];
+    return get_reader(*_pages[record.page]).read<T>(uint64_t(record.offset) + 6 + _members[i_field].offset);
+}
 
-        for (auto& record_index: record_indices)
+void Exd::decode_columns()
+{
+    const uint32_t row_count = _records.size();
+
+    std::vector<Column> columns(_members.size());
+    for (uint32_t i = 0; i < _members.size(); ++i)
+    {
+        columns[i].type = _members[i].type;
+        columns[i].values.resize((_members[i].type == DataType::boolean) ? (row_count + 7) / 8 : row_count * get_value_size(_members[i].type));
+    }
+    std::vector<char> strings(1, '\0');
+
+    for (uint32_t row = 0; row < row_count; ++row)
+    {
+        for (uint32_t i = 0; i < _members.size(); ++i)
         {
-            // Get the vector fields for the given record and preallocate it
-            auto& fields = _data[record_index.id];
-            fields.reserve(member_count);
+            auto& values = columns[i].values;
 
-            for (auto& member_entry: i_exh.get_members())
+            // Switch depending on the type to extract
+            switch (_members[i].type)
             {
-                // Seek to the position of the member to extract.
-                // 6 is because we have uint32_t/uint16_t at the start of each record
-                stream.seekg(record_index.offset + 6 + member_entry.second.offset);
-
-                // Switch depending on the type to extract
-                switch (member_entry.second.type)
+            case DataType::string:
+            {
+                auto string = get_cstring(row, i);
+                uint32_t string_offset = 0;
+                if (*string != '\0')
                 {
-                case DataType::string:
-                    // Extract the offset to the actual string
-                    // Seek to it then extract the actual string
+                    string_offset = strings.size();
+                    strings.insert(strings.end(), string, string + std::strlen(string) + 1);
+                }
+                store_value(values, row, string_offset);
+            }
+            break;
+
+            case DataType::boolean:
+                if (read_value<bool>(row, i))
                 {
-                    auto string_offset = extract<xiv_exd_logger, uint32_t>(stream, "string_offset", utils::log::Severity::trace, false);
-                    stream.seekg(record_index.offset + 6 + i_exh.get_header().data_offset + string_offset);
-                    fields.emplace_back(utils::bparse::extract_cstring<xiv_exd_logger>(stream, "string", utils::log::Severity::trace));
+                    values[row / 8] |= uint8_t(1 << (row % 8));
                 }
                 break;
 
-                case DataType::boolean:
-                    fields.emplace_back(extract<xiv_exd_logger, bool>(stream, "bool", utils::log::Severity::trace));
-                    break;
-
-                case DataType::int8:
-                    fields.emplace_back(extract<xiv_exd_logger, int8_t>(stream, "int8_t", utils::log::Severity::trace));
-                    break;
+            case DataType::int8:
+                store_value(values, row, read_value<int8_t>(row, i));
+                break;
 
-                case DataType::uint8:
-                    fields.emplace_back(extract<xiv_exd_logger, uint8_t>(stream, "uint8_t", utils::log::Severity::trace));
-                    break;
+            case DataType::uint8:
+                store_value(values, row, read_value<uint8_t>(row, i));
+                break;
 
-                case DataType::int16:
-                    fields.emplace_back(extract<xiv_exd_logger, int16_t>(stream, "int16_t", utils::log::Severity::trace, false));
-                    break;
+            case DataType::int16:
+                store_value(values, row, read_value<int16_t>(row, i));
+                break;
 
-                case DataType::uint16:
-                    fields.emplace_back(extract<xiv_exd_logger, uint16_t>(stream, "uint16_t", utils::log::Severity::trace, false));
-                    break;
+            case DataType::uint16:
+                store_value(values, row, read_value<uint16_t>(row, i));
+                break;
 
-                case DataType::int32:
-                    fields.emplace_back(extract<xiv_exd_logger, int32_t>(stream, "int32_t", utils::log::Severity::trace, false));
-                    break;
+            case DataType::int32:
+                store_value(values, row, read_value<int32_t>(row, i));
+                break;
 
-                case DataType::uint32:
-                    fields.emplace_back(extract<xiv_exd_logger, uint32_t>(stream, "uint32_t", utils::log::Severity::trace, false));
-                    break;
+            case DataType::uint32:
+                store_value(values, row, read_value<uint32_t>(row, i));
+                break;
 
-                case DataType::float32:
-                    fields.emplace_back(extract<xiv_exd_logger, float>(stream, "float", utils::log::Severity::trace, false));
-                    break;
+            case DataType::float32:
+                store_value(values, row, read_value<float>(row, i));
+                break;
 
-                case DataType::uint64:
-                    fields.emplace_back(extract<xiv_exd_logger, uint64_t>(stream, "uint64_t", utils::log::Severity::trace, false));
-                    break;
+            case DataType::uint64:
+                store_value(values, row, read_value<uint64_t>(row, i));
+                break;
 
-                default:
-                    throw std::runtime_error("Unknown DataType: " + std::to_string(static_cast<uint16_t>(member_entry.second.type)));
-                    break;
-                }
+            default:
+                throw std::runtime_error("Unknown DataType: " + std::to_string(static_cast<uint16_t>(_members[i].type)));
+                break;
             }
         }
     }
+    strings.shrink_to_fit();
+
+    // From now on the reads are served by the columns, the pages are not needed anymore
+    _columns = std::move(columns);
+    _strings = std::move(strings);
+    _pages.clear();
+    _pages.shrink_to_fit();
+    _is_decoded = true;
 }
 
 Exd::~Exd()
 {
 }
 
-const std::vector<Field>& Exd::get_row(uint32_t id)
+uint32_t Exd::get_row_count() const
+{
+    return _records.size();
+}
+
+uint32_t Exd::get_field_count() const
+{
+    return _members.size();
+}
+
+DataType Exd::get_field_type(uint32_t i_field) const
+{
+    return _members.at(i_field).type;
+}
+
+bool Exd::is_decoded() const
+{
+    return _is_decoded;
+}
+
+ExdRow Exd::get_row(uint32_t id) const
 {
-    auto row_it = _data.find(id);
-    if (row_it == _data.end())
+    auto record_it = std::lower_bound(_records.begin(), _records.end(), id, [](const Record& i_record, uint32_t i_id) {
+        return i_record.id < i_id;
+    });
+    if (record_it == _records.end() || record_it->id != id)
     {
         throw std::runtime_error("Id not found: " + std::to_string(id));
     }
 
-    return row_it->second;
+    return ExdRow(*this, record_it - _records.begin());
+}
+
+ExdRow Exd::get_row_at(uint32_t i_row) const
+{
+    if (i_row >= _records.size())
+    {
+        throw std::runtime_error("Row out of range: " + std::to_string(i_row));
+    }
+
+    return ExdRow(*this, i_row);
 }
 
 // Get all rows
-const std::map<uint32_t, std::vector<Field>>& Exd::get_rows()
+std::vector<ExdRow> Exd::get_rows() const
+{
+    std::vector<ExdRow> rows;
+    rows.reserve(_records.size());
+    for (uint32_t i = 0; i < _records.size(); ++i)
+    {
+        rows.emplace_back(*this, i);
+    }
+    return rows;
+}
+
+std::size_t Exd::get_memory_usage() const
+{
+    std::size_t memory_usage = _records.capacity() * sizeof(Record) + _members.capacity() * sizeof(ExhMember) +
+                               _columns.capacity() * sizeof(Column) + _strings.capacity();
+    for (auto& column: _columns)
+    {
+        memory_usage += column.values.capacity();
+    }
+    for (auto& page: _pages)
+    {
+        memory_usage += page->get_size();
+    }
+    return memory_usage;
+}
+
+Field Exd::get_field(uint32_t i_row, uint32_t i_field) const
+{
+    const DataType type = get_field_type(i_field);
+    if (type == DataType::string)
+    {
+        return std::string(get_cstring(i_row, i_field));
+    }
+
+    if (_is_decoded)
+    {
+        auto& values = _columns[i_field].values;
+        switch (type)
+        {
+        case DataType::boolean:
+            return bool((values[i_row / 8] >> (i_row % 8)) & 1);
+
+        case DataType::int8:
+            return load_value<int8_t>(values, i_row);
+
+        case DataType::uint8:
+            return load_value<uint8_t>(values, i_row);
+
+        case DataType::int16:
+            return load_value<int16_t>(values, i_row);
+
+        case DataType::uint16:
+            return load_value<uint16_t>(values, i_row);
+
+        case DataType::int32:
+            return load_value<int32_t>(values, i_row);
+
+        case DataType::uint32:
+            return load_value<uint32_t>(values, i_row);
+
+        case DataType::float32:
+            return load_value<float>(values, i_row);
+
+        case DataType::uint64:
+            return load_value<uint64_t>(values, i_row);
+
+        default:
+            break;
+        }
+    }
+    else
+    {
+        switch (type)
+        {
+        case DataType::boolean:
+            return read_value<bool>(i_row, i_field);
+
+        case DataType::int8:
+            return read_value<int8_t>(i_row, i_field);
+
+        case DataType::uint8:
+            return read_value<uint8_t>(i_row, i_field);
+
+        case DataType::int16:
+            return read_value<int16_t>(i_row, i_field);
+
+        case DataType::uint16:
+            return read_value<uint16_t>(i_row, i_field);
+
+        case DataType::int32:
+            return read_value<int32_t>(i_row, i_field);
+
+        case DataType::uint32:
+            return read_value<uint32_t>(i_row, i_field);
+
+        case DataType::float32:
+            return read_value<float>(i_row, i_field);
+
+        case DataType::uint64:
+            return read_value<uint64_t>(i_row, i_field);
+
+        default:
+            break;
+        }
+    }
+    throw std::runtime_error("Unknown DataType: " + std::to_string(static_cast<uint16_t>(type)));
+}
+
+const char* Exd::get_cstring(uint32_t i_row, uint32_t i_field) const
 {
-    return _data;
+    if (get_field_type(i_field) != DataType::string)
+    {
+        throw std::runtime_error("Field is not a string: " + std::to_string(i_field));
+    }
+
+    if (_is_decoded)
+    {
+        return _strings.data() + load_value<uint32_t>(_columns[i_field].values, i_row);
+    }
+
+    // The string is used in place, its null must be in the page
+    auto& record = _records[i_row];
+    auto& data_section = _pages[record.page]->get_data_sections().front();
+    auto reader = get_reader(*_pages[record.page]);
+    const uint64_t row_offset = uint64_t(record.offset) + 6;
+    const char* string_end;
+    auto string_begin = reader.read_cstring(row_offset + _data_offset + read_value<uint32_t>(i_row, i_field), string_end);
+    if (string_end == data_section.data() + data_section.size())
+    {
+        throw std::runtime_error("String not terminated in exd - id: " + std::to_string(record.id) + " - field: " + std::to_string(i_field));
+    }
+    return string_begin;
 }
 
 class output_field : public boost::static_visitor<>
@@ -186,12 +575,13 @@ void Exd::get_as_csv(std::ostream& o_stream) const
 
     auto visitor = boost::bind(output_field(), _1, boost::ref(o_stream), delimiter);
 
-    for (auto& row_entry: _data)
+    for (uint32_t i = 0; i < _records.size(); ++i)
     {
-        o_stream << row_entry.first;
+        o_stream << _records[i].id;
 
-        for (auto& field: row_entry.second)
+        for (uint32_t j = 0; j < _members.size(); ++j)
         {
+            auto field = get_field(i, j);
             boost::apply_visitor(visitor, field);
         }
 
@@ -1,6 +1,7 @@
 #include <xiv/exd/ExdData.h>
 
 #include <xiv/utils/stream.h>
+#include <xiv/utils/thread_pool.h>
 
 #include <xiv/dat/GameData.h>
 #include <xiv/dat/File.h>
@@ -8,19 +9,28 @@
 #include <xiv/exd/logger.h>
 #include <xiv/exd/Cat.h>
 
+namespace
+{
+// Hashed at compile time
+constexpr xiv::dat::PathHash root_exl_path_hash("exd/root.exl");
+}
+
 namespace xiv
 {
 namespace exd
 {
 
-ExdData::ExdData(dat::GameData& i_game_data) try :
-    _game_data(i_game_data)
+ExdData::ExdData(dat::GameData& i_game_data, bool i_decode_all, const std::vector<Language>& i_languages) try :
+    _game_data(i_game_data),
+    _decode_all(i_decode_all),
+    _languages(i_languages)
 {
     XIV_INFO(xiv_exd_logger, "Initializing ExdData");
 
     // Fetch the root.exl and get a stream from it
-    auto root_exl = i_game_data.get_file("exd/root.exl");
-    auto stream_ptr = utils::stream::get_istream(root_exl->get_data_sections().front());
+    auto root_exl = i_game_data.get_file(root_exl_path_hash);
+    auto& data_section = root_exl->get_data_sections().front();
+    auto stream_ptr = utils::stream::get_istream(data_section.data(), data_section.size());
     auto& stream = *stream_ptr;
 
     // Iterates over the lines while skipping the first one
@@ -38,11 +48,9 @@ ExdData::ExdData(dat::GameData& i_game_data) try :
         auto category = line.substr(0, sep);
 
         // Add to the list of category name
-        // creates the empty category in the cats map
-        // instantiate the creation mutex for this category
+        // creates the empty slot of the category in the cats map
         _cat_names.push_back(category);
-        _cats[category] = std::unique_ptr<Cat>();
-        _cat_creation_mutexes[category] = std::unique_ptr<std::mutex>(new std::mutex());
+        _cats[category] = std::unique_ptr<CategorySlot>(new CategorySlot());
 
         std::getline(stream, line);
     }
@@ -64,7 +72,12 @@ const std::vector<std::string>& ExdData::get_cat_names() const
     return _cat_names;
 }
 
-const Cat& ExdData::get_category(const std::string& i_cat_name)
+ExdData::CategorySlot::CategorySlot() :
+    cat(nullptr)
+{
+}
+
+ExdData::CategorySlot& ExdData::get_category_slot(const std::string& i_cat_name)
 {
     // Get the category from its name
     auto cat_it = _cats.find(i_cat_name);
@@ -72,38 +85,93 @@ const Cat& ExdData::get_category(const std::string& i_cat_name)
     {
         throw std::runtime_error("Category not found: " + i_cat_name);
     }
+    return *cat_it->second;
+}
 
-    if (cat_it->second)
-    {
-        // If valid return it
-        return *(cat_it->second);
-    }
-    else
+const Cat& ExdData::get_category(const std::string& i_cat_name)
+{
+    auto& slot = get_category_slot(i_cat_name);
+
+    // Fast path: already created
+    if (auto cat = slot.cat.load(std::memory_order_acquire))
     {
-        // If not, create it and return it
-        create_category(i_cat_name);
-        return *(_cats[i_cat_name]);
+        return *cat;
     }
+    return create_category(i_cat_name, slot);
 }
 
-void ExdData::create_category(const std::string& i_cat_name)
+const Cat& ExdData::create_category(const std::string& i_cat_name, CategorySlot& io_slot)
 {
     // Lock mutex in this scope
-    std::lock_guard<std::mutex> lock(*(_cat_creation_mutexes[i_cat_name]));
+    std::lock_guard<std::mutex> lock(io_slot.creation_mutex);
     // Maybe after unlocking it has already been created, so check (most likely if it blocked)
-    if (!_cats[i_cat_name])
+    if (!io_slot.owned_cat)
     {
-        _cats[i_cat_name] = std::unique_ptr<Cat>(new Cat(_game_data, i_cat_name));
+        io_slot.owned_cat = std::unique_ptr<Cat>(new Cat(_game_data, i_cat_name, _decode_all, _languages));
+        io_slot.cat.store(io_slot.owned_cat.get(), std::memory_order_release);
     }
+    return *io_slot.owned_cat;
 }
 
-void ExdData::export_as_csvs(const boost::filesystem::path& i_output_path)
+void ExdData::load_all(utils::thread_pool::ThreadPool* i_pool)
 {
-    auto csv_output_path = i_output_path / "csv";
+    // One task per sheet and language, the categories are created by the first of their tasks
+    std::vector<std::pair<const std::string*, Language>> sheets;
+    auto load_sheets = [&](utils::thread_pool::ThreadPool& i_pool) {
+        i_pool.parallel_for(_cat_names.size(), [this](uint32_t i) {
+            get_category(_cat_names[i]);
+        });
+
+        for (auto& cat_name: _cat_names)
+        {
+            for (auto language: get_category(cat_name).get_languages())
+            {
+                sheets.emplace_back(&cat_name, language);
+            }
+        }
+        i_pool.parallel_for(sheets.size(), [&](uint32_t i) {
+            get_category(*sheets[i].first).get_data_ln(sheets[i].second);
+        });
+    };
+    if (i_pool)
+    {
+        load_sheets(*i_pool);
+    }
+    else
+    {
+        utils::thread_pool::ThreadPool load_pool;
+        load_sheets(load_pool);
+    }
+}
 
-    for (auto& cat_name: get_cat_names())
+void ExdData::export_as_csvs(const boost::filesystem::path& i_output_path, utils::thread_pool::ThreadPool* i_pool)
+{
+    auto csv_output_path = i_output_path / "csv";
+    boost::filesystem::create_directories(csv_output_path);
+
+    // Each task holds at most one sheet, a single language of a category (see Cat::export_as_csvs), so there are never more sheets in memory than workers plus the caller
+    auto export_sheets = [&](utils::thread_pool::ThreadPool& i_pool) {
+        i_pool.parallel_for(_cat_names.size(), [&](uint32_t i) {
+            auto& cat_name = _cat_names[i];
+            if (auto cat = get_category_slot(cat_name).cat.load(std::memory_order_acquire))
+            {
+                cat->export_as_csvs(csv_output_path);
+            }
+            else
+            {
+                // Not kept: exporting everything must not load everything
+                Cat(_game_data, cat_name, _decode_all, _languages).export_as_csvs(csv_output_path);
+            }
+        });
+    };
+    if (i_pool)
+    {
+        export_sheets(*i_pool);
+    }
+    else
     {
-        get_category(cat_name).export_as_csvs(csv_output_path);
+        utils::thread_pool::ThreadPool export_pool;
+        export_sheets(export_pool);
     }
 }
 
@@ -15,7 +15,8 @@ namespace exd
 Exh::Exh(const dat::File& i_file)
 {
     // Get a stream from the file
-    auto stream_ptr = utils::stream::get_istream(i_file.get_data_sections().front());
+    auto& data_section = i_file.get_data_sections().front();
+    auto stream_ptr = utils::stream::get_istream(data_section.data(), data_section.size());
     auto& stream = *stream_ptr;
 
     // Extract header and skip to member definitions
@@ -3,18 +3,47 @@
 
 #include <string>
 #include <cstdint>
+#include <cstddef>
 #include <vector>
+#include <functional>
+
+#include <xiv/utils/bparse.h>
+
+// Implementations of the crc loop
+// table => byte at a time on a single table, the reference
+// slicing_by_16 => 16 bytes per step on 16 tables, always available
+// pclmul => carry-less multiply folding, x86 with PCLMULQDQ only, pays off from 64 bytes
+XIV_ENUM((xiv)(utils)(crc32), Kernel, uint32_t,
+         XIV_VALUE(table,         0)
+         XIV_VALUE(slicing_by_16, 1)
+         XIV_VALUE(pclmul,        2));
 
 namespace xiv
 {
 namespace utils
 {
+namespace thread_pool
+{
+class ThreadPool;
+}
 namespace crc32
 {
 
-// Normal crc32 computation from a given intial crc value, use zlib.crc32 instead, the final XOR 0xFFFFFFFF is not done
+// Normal crc32 computation from a given intial crc value, the final XOR 0xFFFFFFFF is not done
 uint32_t compute(const std::string& i_input, uint32_t init_crc = 0xFFFFFFFF);
 
+// Runs the crc over i_size bytes from i_crc, the final XOR 0xFFFFFFFF is not done like in the exe
+// pclmul is used when the cpu has it and the buffer is long enough, slicing_by_16 otherwise
+uint32_t update(uint32_t i_crc, const char* i_data, std::size_t i_size);
+// Same with a given kernel, throws if it is not available
+uint32_t update(Kernel i_kernel, uint32_t i_crc, const char* i_data, std::size_t i_size);
+
+// Whether a kernel is built in and supported by the cpu
+bool is_kernel_available(Kernel i_kernel);
+
+// The 0x100 entries table of the byte at a time loop, for callers running their own
+const uint32_t* get_table();
+
 // Computes the 4 missing bytes XXXX such as init_crc = crc32(prefix_string)
 // and string_to_find = prefix_string + XXXX + i_input
 uint32_t rev_compute(const std::string& i_input, uint32_t init_crc = 0);
@@ -22,6 +51,35 @@ uint32_t rev_compute(const std::string& i_input, uint32_t init_crc = 0);
 void generate_hashes_1(std::string& i_format, const uint32_t i_first_index, std::vector<uint32_t>& o_hashes);
 void generate_hashes_2(std::string& i_format, const uint32_t i_first_index, const uint32_t i_second_index, std::vector<uint32_t>& o_hashes);
 
+// A candidate accepted by a search: the values of the digit groups and the hash of the string
+struct HashHit
+{
+    uint32_t first_value;
+    uint32_t second_value;
+    uint32_t hash;
+};
+
+// Inclusive range of the values of a digit group, only these candidates are hashed by a search
+struct DigitRange
+{
+    uint32_t min_value;
+    uint32_t max_value;
+};
+const DigitRange full_digit_range = { 0, 9999 };
+
+// Number of candidates generated at once by a search before they are passed to the filter, fits in L1
+const uint32_t search_chunk_size = 0x400;
+
+// Same candidates as generate_hashes_1/2, restricted to the given ranges, but they are never all stored: they are generated by chunks and
+// i_filter is called on each hash right away, only the accepted ones are returned, sorted by values
+// search_hashes_2 splits the candidate space across i_pool, or a temporary pool if it is null, so i_filter is called concurrently and must be thread safe
+// Throws if a range is empty or goes past 9999
+std::vector<HashHit> search_hashes_1(const std::string& i_format, uint32_t i_first_index, const std::function<bool(uint32_t)>& i_filter,
+                                     const DigitRange& i_first_range = full_digit_range);
+std::vector<HashHit> search_hashes_2(const std::string& i_format, uint32_t i_first_index, uint32_t i_second_index, const std::function<bool(uint32_t)>& i_filter,
+                                     thread_pool::ThreadPool* i_pool = nullptr,
+                                     const DigitRange& i_first_range = full_digit_range, const DigitRange& i_second_range = full_digit_range);
+
 }
 }
 }
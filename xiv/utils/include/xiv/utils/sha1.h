@@ -0,0 +1,63 @@
+#ifndef XIV_UTILS_SHA1_H
+#define XIV_UTILS_SHA1_H
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+#include <xiv/utils/bparse.h>
+
+// Implementations of the block function
+// portable => plain C++, always available
+// sha_ni => x86 SHA extensions, only if the cpu has them
+XIV_ENUM((xiv)(utils)(sha1), Kernel, uint32_t,
+         XIV_VALUE(portable, 0)
+         XIV_VALUE(sha_ni,   1));
+
+namespace xiv
+{
+namespace utils
+{
+namespace sha1
+{
+
+const std::size_t digest_size = 0x14;
+typedef std::array<uint8_t, digest_size> Digest;
+
+// Incremental SHA-1, the data can be given in as many parts as needed
+class Sha1
+{
+public:
+    // sha_ni if the cpu has it, portable otherwise
+    Sha1();
+    // Throws if the kernel is not available
+    explicit Sha1(Kernel i_kernel);
+
+    void update(const char* i_data, std::size_t i_size);
+    // Pads and returns the digest, update must not be called after it
+    Digest finalize();
+
+protected:
+    void process_blocks(const uint8_t* i_data, std::size_t i_block_count);
+
+    Kernel _kernel;
+    uint32_t _state[5];
+    // Total size given to update, in bytes
+    uint64_t _size;
+    // Start of an incomplete block
+    uint8_t _buffer[0x40];
+    uint32_t _buffer_size;
+};
+
+// One shot versions
+Digest compute(const char* i_data, std::size_t i_size);
+Digest compute(Kernel i_kernel, const char* i_data, std::size_t i_size);
+
+// Whether a kernel is built in and supported by the cpu
+bool is_kernel_available(Kernel i_kernel);
+
+}
+}
+}
+
+#endif // XIV_UTILS_SHA1_H
@@ -16,6 +16,8 @@ namespace stream
 // CAUTION! If you modify the data vector while parsing the stream, shit may happen!
 // This does not copy the data, it only iterates over the vector by initializing the pointers of the streambuf correctly
 std::unique_ptr<std::basic_istream<char>> get_istream(const std::vector<char>& i_source);
+// Same but for any contiguous memory area
+std::unique_ptr<std::basic_istream<char>> get_istream(const char* i_data, std::size_t i_size);
 
 std::unique_ptr<std::basic_ostream<char>> get_ostream(std::vector<char>& i_source);
 
@@ -0,0 +1,54 @@
+#ifndef XIV_UTILS_THREAD_POOL_H
+#define XIV_UTILS_THREAD_POOL_H
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <vector>
+
+namespace xiv
+{
+namespace utils
+{
+namespace thread_pool
+{
+
+// Fixed number of worker threads running queued tasks
+class ThreadPool
+{
+public:
+    // 0 means one thread per hardware thread
+    explicit ThreadPool(uint32_t i_thread_count = 0);
+    // Runs the tasks still queued then joins the workers
+    ~ThreadPool();
+
+    uint32_t get_thread_count() const;
+
+    // Queues a task, it will be run by one of the workers, it must not throw
+    void push(std::function<void()> i_task);
+
+    // Runs i_task(i) for every i in [0, i_count) and returns when they are all done
+    // The calling thread takes part in the work, so it is safe to call from inside a task of the same pool
+    // If a task throws, the first exception is rethrown here once all the tasks are done
+    void parallel_for(uint32_t i_count, const std::function<void(uint32_t)>& i_task);
+
+protected:
+    // Main loop of the workers
+    void work();
+
+    std::vector<std::thread> _threads;
+
+    std::mutex _tasks_mutex;
+    std::condition_variable _tasks_cv;
+    std::queue<std::function<void()>> _tasks;
+    bool _stopping;
+};
+
+}
+}
+}
+
+#endif // XIV_UTILS_THREAD_POOL_H
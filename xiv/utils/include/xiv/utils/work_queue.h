@@ -0,0 +1,104 @@
+#ifndef XIV_UTILS_WORK_QUEUE_H
+#define XIV_UTILS_WORK_QUEUE_H
+
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <utility>
+
+namespace xiv
+{
+namespace utils
+{
+namespace work_queue
+{
+
+// Bounded multi-producer multi-consumer queue, to hand work from one stage to the next
+// push blocks while the queue is full, so a fast producer waits for its consumers instead of piling up items
+// pop blocks while it is empty, until an item comes or the queue is closed
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(uint32_t i_capacity) :
+        _capacity(i_capacity ? i_capacity : 1),
+        _is_closed(false)
+    {
+    }
+
+    // Waits for room then queues the item, returns false without queuing it if the queue is closed
+    bool push(T i_item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_full_cv.wait(lock, [this] { return _is_closed || _items.size() < _capacity; });
+            if (_is_closed)
+            {
+                return false;
+            }
+            _items.push(std::move(i_item));
+        }
+        _not_empty_cv.notify_one();
+        return true;
+    }
+
+    // Waits for an item and moves it to o_item, returns false once the queue is closed and empty
+    bool pop(T& o_item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_empty_cv.wait(lock, [this] { return _is_closed || !_items.empty(); });
+            if (_items.empty())
+            {
+                return false;
+            }
+            o_item = std::move(_items.front());
+            _items.pop();
+        }
+        _not_full_cv.notify_one();
+        return true;
+    }
+
+    // No more pushes: the waiting producers give up, the consumers get what is left then stop
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _is_closed = true;
+        }
+        _not_full_cv.notify_all();
+        _not_empty_cv.notify_all();
+    }
+
+    uint32_t get_capacity() const
+    {
+        return _capacity;
+    }
+
+    // Number of queued items, only a hint when other threads use the queue
+    uint32_t get_size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _items.size();
+    }
+
+protected:
+    const uint32_t _capacity;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _not_full_cv;
+    std::condition_variable _not_empty_cv;
+    std::queue<T> _items;
+    bool _is_closed;
+
+private:
+    BoundedQueue(const BoundedQueue&);
+    BoundedQueue& operator=(const BoundedQueue&);
+};
+
+}
+}
+}
+
+#endif // XIV_UTILS_WORK_QUEUE_H
@@ -4,6 +4,15 @@
 #include <cstdint>
 #include <vector>
 
+#include <xiv/utils/bparse.h>
+
+// Decoders available for raw deflate data
+// zlib => streaming inflate, always available
+// libdeflate => one-shot whole-buffer decoder, only if built with XIV_USE_LIBDEFLATE
+XIV_ENUM((xiv)(utils)(zlib), Backend, uint32_t,
+         XIV_VALUE(zlib,       0)
+         XIV_VALUE(libdeflate, 1));
+
 namespace xiv
 {
 namespace utils
@@ -12,7 +21,38 @@ namespace zlib
 {
 
 void compress(const std::vector<char>& in, std::vector<char>& out);
-void no_header_decompress(uint8_t* in, uint32_t in_size, uint8_t* out, uint32_t out_size);
+
+// Decompresses raw deflate data (no header), out_size must be the exact uncompressed size
+// Uses a Decompressor of the default backend owned by the calling thread
+void no_header_decompress(const uint8_t* in, uint32_t in_size, uint8_t* out, uint32_t out_size);
+
+// Whether a backend has been built in
+bool is_backend_available(Backend i_backend);
+// libdeflate if it has been built in, zlib otherwise
+Backend get_default_backend();
+
+// Reusable raw deflate decoder: the backend state is allocated once then only reset between calls
+// Not thread-safe, use one per thread
+class Decompressor
+{
+public:
+    explicit Decompressor(Backend i_backend = get_default_backend());
+    ~Decompressor();
+
+    Backend get_backend() const;
+
+    // Same as the free function but on this decoder state
+    void no_header_decompress(const uint8_t* in, uint32_t in_size, uint8_t* out, uint32_t out_size);
+
+protected:
+    Backend _backend;
+    // z_stream or libdeflate_decompressor depending on the backend
+    void* _state;
+
+private:
+    Decompressor(const Decompressor&);
+    Decompressor& operator=(const Decompressor&);
+};
 
 }
 }
@@ -1,67 +1,305 @@
 #include <xiv/utils/crc32.h>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <mutex>
-#include <vector>
+#include <stdexcept>
 
-#include <zlib.h>
+#include <xiv/utils/thread_pool.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define XIV_CRC32_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#define XIV_CRC32_TARGET_PCLMUL
+#else
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+// gcc/clang only emit pclmulqdq in functions marked for it, the rest of the tree stays buildable for any x86
+#define XIV_CRC32_TARGET_PCLMUL __attribute__((target("sse2,pclmul")))
+#endif
+#endif
 
 namespace internal
 {
-// Mutex to prevent two threads from concurrently trying to build the crc tables atthe same time
-std::mutex crc_creation_mutex;
 
-typedef std::vector<uint32_t> CrcTable;
+// Bitwise crc32 step on the reflected polynomial, crc_bits(i, 8) is the entry i of the classical table
+constexpr uint32_t crc_bits(uint32_t i_crc, uint32_t i_bit_count)
+{
+    return (i_bit_count == 0) ? i_crc : crc_bits((i_crc & 1) ? (0xEDB88320 ^ (i_crc >> 1)) : (i_crc >> 1), i_bit_count - 1);
+}
+
+// Compile time list 0..N-1, std::index_sequence is C++14
+template <uint32_t... Is> struct IndexList {};
+template <uint32_t N, uint32_t... Is> struct MakeIndexList : MakeIndexList<N - 1, N - 1, Is...> {};
+template <uint32_t... Is> struct MakeIndexList<0, Is...> { typedef IndexList<Is...> type; };
+
+// slices[k][i] is the crc of the byte i followed by k zero bytes, slices[0] is the classical table
+struct SliceTables
+{
+    uint32_t slices[16][0x100];
+};
+
+template <uint32_t... Is>
+constexpr SliceTables make_slice_tables(IndexList<Is...>)
+{
+    return SliceTables{ {
+        { crc_bits(Is, 8)... },   { crc_bits(Is, 16)... },  { crc_bits(Is, 24)... },  { crc_bits(Is, 32)... },
+        { crc_bits(Is, 40)... },  { crc_bits(Is, 48)... },  { crc_bits(Is, 56)... },  { crc_bits(Is, 64)... },
+        { crc_bits(Is, 72)... },  { crc_bits(Is, 80)... },  { crc_bits(Is, 88)... },  { crc_bits(Is, 96)... },
+        { crc_bits(Is, 104)... }, { crc_bits(Is, 112)... }, { crc_bits(Is, 120)... }, { crc_bits(Is, 128)... }
+    } };
+}
+
+// Built by the compiler: nothing to initialize, nor to lock, at runtime
+constexpr SliceTables slice_tables = make_slice_tables(MakeIndexList<0x100>::type());
+
+typedef std::array<uint32_t, 0x100> RevCrcTable;
+
+RevCrcTable build_rev_crc_table()
+{
+    RevCrcTable rev_crc_table;
+    for (uint32_t i = 0; i < 0x100; ++i)
+    {
+        const auto crc = slice_tables.slices[0][i];
+        rev_crc_table[crc >> 24] = i + ((crc & 0xFFFFFF) << 8);
+    }
+    return rev_crc_table;
+}
+
+const RevCrcTable& get_rev_crc_table()
+{
+    // Function static so the init is thread-safe
+    static const RevCrcTable rev_crc_table = build_rev_crc_table();
+    return rev_crc_table;
+}
+
+uint32_t update_table(uint32_t i_crc, const uint8_t* i_data, std::size_t i_size)
+{
+    auto& crc_table = slice_tables.slices[0];
+    auto crc = i_crc;
+    for (std::size_t i = 0; i < i_size; ++i)
+    {
+        crc = crc_table[(crc ^ i_data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+// Little endian read, like every cpu the game runs on
+inline uint32_t read_uint32(const uint8_t* i_data)
+{
+    uint32_t value;
+    std::memcpy(&value, i_data, sizeof(value));
+    return value;
+}
+
+uint32_t update_slicing_by_16(uint32_t i_crc, const uint8_t* i_data, std::size_t i_size)
+{
+    auto& t = slice_tables.slices;
+    auto crc = i_crc;
+    while (i_size >= 16)
+    {
+        // The crc only mixes with the first 4 bytes, the 16 lookups are independent of each other
+        const uint32_t w0 = read_uint32(i_data) ^ crc;
+        const uint32_t w1 = read_uint32(i_data + 4);
+        const uint32_t w2 = read_uint32(i_data + 8);
+        const uint32_t w3 = read_uint32(i_data + 12);
+        crc = t[15][w0 & 0xFF] ^ t[14][(w0 >> 8) & 0xFF] ^ t[13][(w0 >> 16) & 0xFF] ^ t[12][w0 >> 24] ^
+              t[11][w1 & 0xFF] ^ t[10][(w1 >> 8) & 0xFF] ^ t[9][(w1 >> 16) & 0xFF]  ^ t[8][w1 >> 24] ^
+              t[7][w2 & 0xFF]  ^ t[6][(w2 >> 8) & 0xFF]  ^ t[5][(w2 >> 16) & 0xFF]  ^ t[4][w2 >> 24] ^
+              t[3][w3 & 0xFF]  ^ t[2][(w3 >> 8) & 0xFF]  ^ t[1][(w3 >> 16) & 0xFF]  ^ t[0][w3 >> 24];
+        i_data += 16;
+        i_size -= 16;
+    }
+    return update_table(crc, i_data, i_size);
+}
+
+#ifdef XIV_CRC32_X86
+// Folding needs 4 blocks of 16 bytes to start, shorter buffers are faster with slicing anyway
+const std::size_t pclmul_min_size = 64;
+
+bool detect_pclmul()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[2] & (1 << 1)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL);
+#endif
+}
+
+bool has_pclmul()
+{
+    static const bool is_supported = detect_pclmul();
+    return is_supported;
+}
+
+// i_x * x^128 mod P folded onto the next 16 bytes
+XIV_CRC32_TARGET_PCLMUL
+inline __m128i fold_16(__m128i i_x, __m128i i_k, __m128i i_next)
+{
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(i_x, i_k, 0x00), _mm_clmulepi64_si128(i_x, i_k, 0x11)), i_next);
+}
+
+// From Intel's "Fast CRC Computation Using PCLMULQDQ Instruction", constants for the reflected 0xEDB88320
+// i_size must be a multiple of 16 and at least pclmul_min_size
+XIV_CRC32_TARGET_PCLMUL
+uint32_t update_pclmul_blocks(uint32_t i_crc, const uint8_t* i_data, std::size_t i_size)
+{
+    // x^(4*128+32) mod P and x^(4*128-32) mod P, folds 4 blocks by 64 bytes
+    const __m128i k1k2 = _mm_set_epi64x(0x1C6E41596, 0x154442BD4);
+    // x^(128+32) mod P and x^(128-32) mod P, folds 1 block by 16 bytes
+    const __m128i k3k4 = _mm_set_epi64x(0x0CCAA009E, 0x1751997D0);
+    // x^64 mod P
+    const __m128i k5 = _mm_set_epi64x(0, 0x163CD6124);
+    // P and floor(x^64 / P) for the Barrett reduction
+    const __m128i poly_mu = _mm_set_epi64x(0x1F7011641, 0x1DB710641);
+    const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
 
-// Our crc/rev_crc tables
-CrcTable crc_table;
-CrcTable rev_crc_table;
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + 0x10));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + 0x20));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(i_crc)));
+    i_data += 0x40;
+    i_size -= 0x40;
 
-bool crc_tables_created = false;
+    while (i_size >= 0x40)
+    {
+        x1 = fold_16(x1, k1k2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data)));
+        x2 = fold_16(x2, k1k2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + 0x10)));
+        x3 = fold_16(x3, k1k2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + 0x20)));
+        x4 = fold_16(x4, k1k2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + 0x30)));
+        i_data += 0x40;
+        i_size -= 0x40;
+    }
+
+    // 4 blocks into 1
+    x1 = fold_16(x1, k3k4, x2);
+    x1 = fold_16(x1, k3k4, x3);
+    x1 = fold_16(x1, k3k4, x4);
+
+    while (i_size >= 0x10)
+    {
+        x1 = fold_16(x1, k3k4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data)));
+        i_data += 0x10;
+        i_size -= 0x10;
+    }
 
-void build_crc_tables()
+    // 128 to 64 bits, this also appends the 32 zero bits of the crc
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(k3k4, x1, 0x01), _mm_srli_si128(x1, 8));
+
+    // 64 to 32 bits
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction, the crc ends up in the second dword
+    x2 = x1;
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly_mu, 0x10);
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly_mu, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+
+uint32_t update_pclmul(uint32_t i_crc, const uint8_t* i_data, std::size_t i_size)
 {
-    std::lock_guard<std::mutex> lock(crc_creation_mutex);
-    if (!crc_tables_created)
+    if (i_size < pclmul_min_size)
     {
-        crc_table.resize(0x100);
-        rev_crc_table.resize(0x100);
-        for (auto i = 0; i < 0x100; ++i)
+        return update_slicing_by_16(i_crc, i_data, i_size);
+    }
+    const auto folded_size = i_size & ~static_cast<std::size_t>(0xF);
+    const auto crc = update_pclmul_blocks(i_crc, i_data, folded_size);
+    return update_slicing_by_16(crc, i_data + folded_size, i_size - folded_size);
+}
+#endif
+
+// The candidates of the generators only differ by 4 digit bytes at known positions and crc is affine over GF(2):
+// for strings of the same size, crc(init, a ^ b) = crc(init, a) ^ crc(0, b)
+// So a candidate crc is the crc of the template with '0' digits xored with the contribution of each digit,
+// and these contributions are computed once per format instead of running the crc over the whole string each time
+const uint32_t digit_group_count = 10000;
+
+void check_digit_group(const std::string& i_format, uint32_t i_index)
+{
+    if (static_cast<std::size_t>(i_index) + 4 > i_format.size())
+    {
+        throw std::runtime_error("Digit group out of format: " + i_format);
+    }
+}
+
+// crc of the format with both digit groups set to "0000"
+uint32_t get_template_crc(const std::string& i_format, uint32_t i_first_index, uint32_t i_second_index)
+{
+    check_digit_group(i_format, i_first_index);
+    check_digit_group(i_format, i_second_index);
+
+    auto format = i_format;
+    std::fill_n(format.begin() + i_first_index, 4, '0');
+    std::fill_n(format.begin() + i_second_index, 4, '0');
+    return xiv::utils::crc32::update(0xFFFFFFFF, format.data(), format.size());
+}
+
+// Contribution of the 4 digits at i_index for every value 0000 to 9999, by value
+std::vector<uint32_t> build_digit_group_crcs(const std::string& i_format, uint32_t i_index)
+{
+    check_digit_group(i_format, i_index);
+
+    // crc from 0 of a string of zeros but one byte, the difference between the digit and '0'
+    std::string difference(i_format.size(), '\0');
+    uint32_t digit_crcs[4][10];
+    for (uint32_t position = 0; position < 4; ++position)
+    {
+        for (uint32_t digit = 0; digit < 10; ++digit)
         {
-            uint32_t crc = i;
-            for (auto j = 0; j < 8; ++j)
-            {
-                if (crc & 1)
-                {
-                    crc = 0xEDB88320 ^ (crc >> 1);
-                }
-                else
-                {
-                    crc = crc >> 1;
-                }
-            }
-            crc_table[i] = crc;
-            rev_crc_table[crc >> 24] = i + ((crc & 0xFFFFFF) << 8);
+            difference[i_index + position] = static_cast<char>(('0' + digit) ^ '0');
+            digit_crcs[position][digit] = xiv::utils::crc32::update(0, difference.data(), difference.size());
         }
+        difference[i_index + position] = '\0';
     }
-    crc_tables_created = true;
+
+    std::vector<uint32_t> group_crcs(digit_group_count);
+    for (uint32_t i = 0; i < digit_group_count; ++i)
+    {
+        group_crcs[i] = digit_crcs[0][i / 1000] ^ digit_crcs[1][(i / 100) % 10] ^ digit_crcs[2][(i / 10) % 10] ^ digit_crcs[3][i % 10];
+    }
+    return group_crcs;
 }
 
-const CrcTable& get_crc_table()
+// Throws if a range of values does not fit in a digit group
+void check_digit_range(const xiv::utils::crc32::DigitRange& i_range, const std::string& i_format)
 {
-    if (!crc_tables_created)
+    if (i_range.min_value > i_range.max_value || i_range.max_value >= digit_group_count)
     {
-        build_crc_tables();
+        throw std::runtime_error("Invalid digit range " + std::to_string(i_range.min_value) + "-" + std::to_string(i_range.max_value) + " in format: " + i_format);
     }
-    return crc_table;
 }
 
-const CrcTable& get_rev_crc_table()
+// Hashes the candidates of a row whose second value is in i_second_range by chunks of search_chunk_size and keeps the ones i_filter accepts, by value of the second digit group
+void search_row(uint32_t i_row_crc, uint32_t i_first_value, const std::vector<uint32_t>& i_second_digit_crcs, const xiv::utils::crc32::DigitRange& i_second_range,
+                const std::function<bool(uint32_t)>& i_filter, std::vector<xiv::utils::crc32::HashHit>& o_hits)
 {
-    if (!crc_tables_created)
+    uint32_t chunk[xiv::utils::crc32::search_chunk_size];
+    const uint32_t range_end = i_second_range.max_value + 1;
+    for (uint32_t chunk_begin = i_second_range.min_value; chunk_begin < range_end; chunk_begin += xiv::utils::crc32::search_chunk_size)
     {
-        build_crc_tables();
+        const uint32_t chunk_size = std::min(xiv::utils::crc32::search_chunk_size, range_end - chunk_begin);
+        for (uint32_t i = 0; i < chunk_size; ++i)
+        {
+            chunk[i] = i_row_crc ^ i_second_digit_crcs[chunk_begin + i];
+        }
+        for (uint32_t i = 0; i < chunk_size; ++i)
+        {
+            if (i_filter(chunk[i]))
+            {
+                o_hits.push_back({ i_first_value, chunk_begin + i, chunk[i] });
+            }
+        }
     }
-    return rev_crc_table;
 }
 }
 
@@ -74,14 +312,67 @@ namespace crc32
 
 uint32_t compute(const std::string& i_input, uint32_t init_crc)
 {
-    // Classical crc stuff
-    auto& crc_table = internal::get_crc_table();
-    auto crc = init_crc;
-    for(std::size_t i = 0; i < i_input.size(); ++i)
+    return update(init_crc, i_input.data(), i_input.size());
+}
+
+uint32_t update(uint32_t i_crc, const char* i_data, std::size_t i_size)
+{
+    auto data = reinterpret_cast<const uint8_t*>(i_data);
+#ifdef XIV_CRC32_X86
+    if (i_size >= internal::pclmul_min_size && internal::has_pclmul())
     {
-        crc = crc_table[(crc ^ i_input[i]) & 0xFF] ^ (crc >> 8);
+        return internal::update_pclmul(i_crc, data, i_size);
     }
-    return crc;
+#endif
+    return internal::update_slicing_by_16(i_crc, data, i_size);
+}
+
+uint32_t update(Kernel i_kernel, uint32_t i_crc, const char* i_data, std::size_t i_size)
+{
+    if (!is_kernel_available(i_kernel))
+    {
+        throw std::runtime_error("crc32 kernel not available: " + std::to_string(static_cast<uint32_t>(i_kernel)));
+    }
+
+    auto data = reinterpret_cast<const uint8_t*>(i_data);
+    switch (i_kernel)
+    {
+    case Kernel::table:
+        return internal::update_table(i_crc, data, i_size);
+
+#ifdef XIV_CRC32_X86
+    case Kernel::pclmul:
+        return internal::update_pclmul(i_crc, data, i_size);
+#endif
+
+    default:
+        return internal::update_slicing_by_16(i_crc, data, i_size);
+    }
+}
+
+bool is_kernel_available(Kernel i_kernel)
+{
+    switch (i_kernel)
+    {
+    case Kernel::table:
+    case Kernel::slicing_by_16:
+        return true;
+
+    case Kernel::pclmul:
+#ifdef XIV_CRC32_X86
+        return internal::has_pclmul();
+#else
+        return false;
+#endif
+
+    default:
+        return false;
+    }
+}
+
+const uint32_t* get_table()
+{
+    return internal::slice_tables.slices[0];
 }
 
 uint32_t rev_compute(const std::string& i_input, uint32_t init_crc)
@@ -104,76 +395,110 @@ uint32_t rev_compute(const std::string& i_input, uint32_t init_crc)
 
 void generate_hashes_1(std::string& i_format, const uint32_t i_first_index, std::vector<uint32_t>& o_hashes)
 {
-    char* str = const_cast<char*>(i_format.data());
-    const uint32_t str_size = i_format.size();
+    const auto base_crc = internal::get_template_crc(i_format, i_first_index, i_first_index);
+    const auto digit_crcs = internal::build_digit_group_crcs(i_format, i_first_index);
 
-    o_hashes.resize(10000);
+    o_hashes.resize(internal::digit_group_count);
+    for (uint32_t i = 0; i < internal::digit_group_count; ++i)
+    {
+        o_hashes[i] = base_crc ^ digit_crcs[i];
+    }
+}
 
-    uint32_t i = 0;
-    for (char a = '0'; a <= '9'; ++a)
+void generate_hashes_2(std::string& i_format, const uint32_t i_first_index, const uint32_t i_second_index, std::vector<uint32_t>& o_hashes)
+{
+    if ((i_first_index < i_second_index + 4) && (i_second_index < i_first_index + 4))
+    {
+        throw std::runtime_error("Digit groups overlap in format: " + i_format);
+    }
+
+    const auto base_crc = internal::get_template_crc(i_format, i_first_index, i_second_index);
+    const auto first_digit_crcs = internal::build_digit_group_crcs(i_format, i_first_index);
+    const auto second_digit_crcs = internal::build_digit_group_crcs(i_format, i_second_index);
+
+    o_hashes.resize(internal::digit_group_count * internal::digit_group_count);
+
+    // Only xors and stores left, one row of 10000 per task
+    thread_pool::ThreadPool pool;
+    pool.parallel_for(internal::digit_group_count, [&](uint32_t i)
     {
-        str[i_first_index] = a;
-        for (char b = '0'; b <= '9'; ++b)
+        const auto row_crc = base_crc ^ first_digit_crcs[i];
+        auto row = o_hashes.data() + i * internal::digit_group_count;
+        for (uint32_t j = 0; j < internal::digit_group_count; ++j)
         {
-            str[i_first_index + 1] = b;
-            for (char c = '0'; c <= '9'; ++c)
-            {
-                str[i_first_index + 2] = c;
-                for (char d = '0'; d <= '9'; ++d)
-                {
-                    str[i_first_index + 3] = d;
-                    o_hashes[i] = ::crc32(0, reinterpret_cast<uint8_t*>(&(str[0])), str_size) ^ 0xFFFFFFFF;
-                    ++i;
-                }
-            }
+            row[j] = row_crc ^ second_digit_crcs[j];
         }
+    });
+}
+
+std::vector<HashHit> search_hashes_1(const std::string& i_format, uint32_t i_first_index, const std::function<bool(uint32_t)>& i_filter,
+                                     const DigitRange& i_first_range)
+{
+    internal::check_digit_range(i_first_range, i_format);
+
+    const auto base_crc = internal::get_template_crc(i_format, i_first_index, i_first_index);
+    const auto digit_crcs = internal::build_digit_group_crcs(i_format, i_first_index);
+
+    // 10^4 candidates are a few microseconds of xors, not worth waking threads for
+    // The only digit group is reported as the second value of the row 0
+    std::vector<HashHit> hits;
+    internal::search_row(base_crc, 0, digit_crcs, i_first_range, i_filter, hits);
+    for (auto& hit : hits)
+    {
+        hit.first_value = hit.second_value;
+        hit.second_value = 0;
     }
+    return hits;
 }
 
-void generate_hashes_2(std::string& i_format, const uint32_t i_first_index, const uint32_t i_second_index, std::vector<uint32_t>& o_hashes)
+std::vector<HashHit> search_hashes_2(const std::string& i_format, uint32_t i_first_index, uint32_t i_second_index, const std::function<bool(uint32_t)>& i_filter,
+                                     thread_pool::ThreadPool* i_pool, const DigitRange& i_first_range, const DigitRange& i_second_range)
 {
-    char* str = const_cast<char*>(i_format.data());
-    const uint32_t str_size = i_format.size();
+    if ((i_first_index < i_second_index + 4) && (i_second_index < i_first_index + 4))
+    {
+        throw std::runtime_error("Digit groups overlap in format: " + i_format);
+    }
+    internal::check_digit_range(i_first_range, i_format);
+    internal::check_digit_range(i_second_range, i_format);
 
-    o_hashes.resize(100000000);
+    const auto base_crc = internal::get_template_crc(i_format, i_first_index, i_second_index);
+    const auto first_digit_crcs = internal::build_digit_group_crcs(i_format, i_first_index);
+    const auto second_digit_crcs = internal::build_digit_group_crcs(i_format, i_second_index);
 
-    uint32_t i = 0;
-    for (char a = '0'; a <= '9'; ++a)
+    std::mutex hits_mutex;
+    std::vector<HashHit> hits;
+
+    // One row per value of the first range, each only over the second range, the hits of a row are few so they are merged right away
+    auto search_rows = [&](thread_pool::ThreadPool& i_rows_pool)
     {
-        str[i_first_index] = a;
-        for (char b = '0'; b <= '9'; ++b)
+        i_rows_pool.parallel_for(i_first_range.max_value - i_first_range.min_value + 1, [&](uint32_t i_row)
         {
-            str[i_first_index + 1] = b;
-            for (char c = '0'; c <= '9'; ++c)
+            const uint32_t i = i_first_range.min_value + i_row;
+            std::vector<HashHit> row_hits;
+            internal::search_row(base_crc ^ first_digit_crcs[i], i, second_digit_crcs, i_second_range, i_filter, row_hits);
+            if (!row_hits.empty())
             {
-                str[i_first_index + 2] = c;
-                for (char d = '0'; d <= '9'; ++d)
-                {
-                    str[i_first_index + 3] = d;
-                    for (char e = '0'; e <= '9'; ++e)
-                    {
-                        str[i_second_index] = e;
-                        for (char f = '0'; f <= '9'; ++f)
-                        {
-                            str[i_second_index + 1] = f;
-                            for (char g = '0'; g <= '9'; ++g)
-                            {
-                                str[i_second_index + 2] = g;
-                                for (char h = '0'; h <= '9'; ++h)
-                                {
-                                    str[i_second_index + 3] = h;
-                                    o_hashes[i] = ::crc32(0, reinterpret_cast<uint8_t*>(&(str[0])), str_size) ^ 0xFFFFFFFF;
-                                    ++i;
-                                }
-                            }
-                        }
-                    }
-                }
+                std::lock_guard<std::mutex> lock(hits_mutex);
+                hits.insert(hits.end(), row_hits.begin(), row_hits.end());
             }
-        }
+        });
+    };
+    if (i_pool)
+    {
+        search_rows(*i_pool);
+    }
+    else
+    {
+        thread_pool::ThreadPool rows_pool;
+        search_rows(rows_pool);
     }
-}
 
+    std::sort(hits.begin(), hits.end(), [](const HashHit& i_lhs, const HashHit& i_rhs)
+    {
+        return (i_lhs.first_value < i_rhs.first_value) || ((i_lhs.first_value == i_rhs.first_value) && (i_lhs.second_value < i_rhs.second_value));
+    });
+    return hits;
+}
 
 }
 }
@@ -0,0 +1,465 @@
+#include <xiv/utils/sha1.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define XIV_SHA1_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#define XIV_SHA1_TARGET_SHA
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+// Same as the crc32 kernels, only the functions marked for it use the extensions
+#define XIV_SHA1_TARGET_SHA __attribute__((target("sha,ssse3,sse4.1")))
+#endif
+#endif
+
+namespace internal
+{
+
+inline uint32_t rotl(uint32_t i_value, uint32_t i_count)
+{
+    return (i_value << i_count) | (i_value >> (32 - i_count));
+}
+
+inline uint32_t read_uint32_be(const uint8_t* i_data)
+{
+    return (uint32_t(i_data[0]) << 24) | (uint32_t(i_data[1]) << 16) | (uint32_t(i_data[2]) << 8) | uint32_t(i_data[3]);
+}
+
+// FIPS 180-4, the schedule is kept as a rolling window of 16 words
+// The 4 round functions have their own loops, 5 rounds per iteration so that the variables rotate by renaming instead of moves
+#define XIV_SHA1_ROUND(a, b, c, d, e, f, k, w) \
+    e += rotl(a, 5) + (f) + (k) + (w);         \
+    b = rotl(b, 30);
+
+#define XIV_SHA1_5_ROUNDS(f, k, i)                                         \
+    XIV_SHA1_ROUND(a, b, c, d, e, f(b, c, d), k, get_word(w, (i)))         \
+    XIV_SHA1_ROUND(e, a, b, c, d, f(a, b, c), k, get_word(w, (i) + 1))     \
+    XIV_SHA1_ROUND(d, e, a, b, c, f(e, a, b), k, get_word(w, (i) + 2))     \
+    XIV_SHA1_ROUND(c, d, e, a, b, f(d, e, a), k, get_word(w, (i) + 3))     \
+    XIV_SHA1_ROUND(b, c, d, e, a, f(c, d, e), k, get_word(w, (i) + 4))
+
+inline uint32_t f_choose(uint32_t b, uint32_t c, uint32_t d)
+{
+    return d ^ (b & (c ^ d));
+}
+
+inline uint32_t f_parity(uint32_t b, uint32_t c, uint32_t d)
+{
+    return b ^ c ^ d;
+}
+
+inline uint32_t f_majority(uint32_t b, uint32_t c, uint32_t d)
+{
+    return (b & c) | (d & (b | c));
+}
+
+// Word i of the schedule, the 16 first ones are the message
+inline uint32_t get_word(uint32_t* io_w, uint32_t i)
+{
+    if (i >= 16)
+    {
+        io_w[i & 0xF] = rotl(io_w[(i - 3) & 0xF] ^ io_w[(i - 8) & 0xF] ^ io_w[(i - 14) & 0xF] ^ io_w[i & 0xF], 1);
+    }
+    return io_w[i & 0xF];
+}
+
+void process_portable(uint32_t* io_state, const uint8_t* i_data, std::size_t i_block_count)
+{
+    for (; i_block_count > 0; --i_block_count, i_data += 0x40)
+    {
+        uint32_t w[16];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            w[i] = read_uint32_be(i_data + 4 * i);
+        }
+
+        uint32_t a = io_state[0];
+        uint32_t b = io_state[1];
+        uint32_t c = io_state[2];
+        uint32_t d = io_state[3];
+        uint32_t e = io_state[4];
+        for (uint32_t i = 0; i < 20; i += 5)
+        {
+            XIV_SHA1_5_ROUNDS(f_choose, 0x5A827999, i)
+        }
+        for (uint32_t i = 20; i < 40; i += 5)
+        {
+            XIV_SHA1_5_ROUNDS(f_parity, 0x6ED9EBA1, i)
+        }
+        for (uint32_t i = 40; i < 60; i += 5)
+        {
+            XIV_SHA1_5_ROUNDS(f_majority, 0x8F1BBCDC, i)
+        }
+        for (uint32_t i = 60; i < 80; i += 5)
+        {
+            XIV_SHA1_5_ROUNDS(f_parity, 0xCA62C1D6, i)
+        }
+
+        io_state[0] += a;
+        io_state[1] += b;
+        io_state[2] += c;
+        io_state[3] += d;
+        io_state[4] += e;
+    }
+}
+
+#undef XIV_SHA1_5_ROUNDS
+#undef XIV_SHA1_ROUND
+
+#ifdef XIV_SHA1_X86
+bool detect_sha_ni()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(regs, 1);
+    const bool has_sse = (regs[2] & (1 << 9)) && (regs[2] & (1 << 19));
+    __cpuidex(regs, 7, 0);
+    return has_sse && (regs[1] & (1 << 29));
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+    {
+        return false;
+    }
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1 << 29));
+#endif
+}
+
+bool has_sha_ni()
+{
+    static const bool is_supported = detect_sha_ni();
+    return is_supported;
+}
+
+// The 80 rounds by groups of 4, the schedule of the next groups is computed while the current one runs
+// From Intel's "New Instructions Supporting the Secure Hash Algorithm on Intel Architecture Processors"
+XIV_SHA1_TARGET_SHA
+void process_sha_ni(uint32_t* io_state, const uint8_t* i_data, std::size_t i_block_count)
+{
+    // The words are big endian and the state is stored as DCBA in the register
+    const __m128i byte_swap = _mm_set_epi64x(0x0001020304050607, 0x08090A0B0C0D0E0F);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(io_state)), 0x1B);
+    __m128i e0 = _mm_set_epi32(static_cast<int>(io_state[4]), 0, 0, 0);
+    __m128i e1;
+    __m128i msg0, msg1, msg2, msg3;
+
+    for (; i_block_count > 0; --i_block_count, i_data += 0x40)
+    {
+        const __m128i abcd_save = abcd;
+        const __m128i e0_save = e0;
+
+        // Rounds 0-3
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data)), byte_swap);
+        e0 = _mm_add_epi32(e0, msg0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        // Rounds 4-7
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + 0x10)), byte_swap);
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+        // Rounds 8-11
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + 0x20)), byte_swap);
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        // Rounds 12-15
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + 0x30)), byte_swap);
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+
+        // Rounds 16-19
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+
+        // Rounds 20-23
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        // Rounds 24-27
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        // Rounds 28-31
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+
+        // Rounds 32-35
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+
+        // Rounds 36-39
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        // Rounds 40-43
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        // Rounds 44-47
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+
+        // Rounds 48-51
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+
+        // Rounds 52-55
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        // Rounds 56-59
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        // Rounds 60-63
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+
+        // Rounds 64-67
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+
+        // Rounds 68-71
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        // Rounds 72-75
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+        // Rounds 76-79
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(io_state), _mm_shuffle_epi32(abcd, 0x1B));
+    io_state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+#endif
+
+xiv::utils::sha1::Kernel get_default_kernel()
+{
+#ifdef XIV_SHA1_X86
+    if (has_sha_ni())
+    {
+        return xiv::utils::sha1::Kernel::sha_ni;
+    }
+#endif
+    return xiv::utils::sha1::Kernel::portable;
+}
+
+}
+
+namespace xiv
+{
+namespace utils
+{
+namespace sha1
+{
+
+Sha1::Sha1() :
+    Sha1(internal::get_default_kernel())
+{
+}
+
+Sha1::Sha1(Kernel i_kernel) :
+    _kernel(i_kernel),
+    _size(0),
+    _buffer_size(0)
+{
+    if (!is_kernel_available(i_kernel))
+    {
+        throw std::runtime_error("sha1 kernel not available: " + std::to_string(static_cast<uint32_t>(i_kernel)));
+    }
+
+    _state[0] = 0x67452301;
+    _state[1] = 0xEFCDAB89;
+    _state[2] = 0x98BADCFE;
+    _state[3] = 0x10325476;
+    _state[4] = 0xC3D2E1F0;
+}
+
+void Sha1::process_blocks(const uint8_t* i_data, std::size_t i_block_count)
+{
+#ifdef XIV_SHA1_X86
+    if (_kernel == Kernel::sha_ni)
+    {
+        internal::process_sha_ni(_state, i_data, i_block_count);
+        return;
+    }
+#endif
+    internal::process_portable(_state, i_data, i_block_count);
+}
+
+void Sha1::update(const char* i_data, std::size_t i_size)
+{
+    auto data = reinterpret_cast<const uint8_t*>(i_data);
+    _size += i_size;
+
+    // Completes the buffered block first
+    if (_buffer_size > 0)
+    {
+        const std::size_t copy_size = std::min<std::size_t>(sizeof(_buffer) - _buffer_size, i_size);
+        std::memcpy(_buffer + _buffer_size, data, copy_size);
+        _buffer_size += copy_size;
+        data += copy_size;
+        i_size -= copy_size;
+        if (_buffer_size < sizeof(_buffer))
+        {
+            return;
+        }
+        process_blocks(_buffer, 1);
+        _buffer_size = 0;
+    }
+
+    // Whole blocks straight from the input
+    const std::size_t block_count = i_size / sizeof(_buffer);
+    process_blocks(data, block_count);
+    data += block_count * sizeof(_buffer);
+    i_size -= block_count * sizeof(_buffer);
+
+    std::memcpy(_buffer, data, i_size);
+    _buffer_size = i_size;
+}
+
+Digest Sha1::finalize()
+{
+    // 0x80, zeros up to 56 mod 64 then the size in bits, big endian
+    const uint64_t bit_size = _size * 8;
+    uint8_t padding[0x48] = { 0x80 };
+    const std::size_t zero_size = (_buffer_size < 56) ? (56 - _buffer_size) : (120 - _buffer_size);
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        padding[zero_size + i] = static_cast<uint8_t>(bit_size >> (56 - 8 * i));
+    }
+    update(reinterpret_cast<const char*>(padding), zero_size + 8);
+
+    Digest digest;
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        digest[4 * i] = static_cast<uint8_t>(_state[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(_state[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(_state[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(_state[i]);
+    }
+    return digest;
+}
+
+Digest compute(const char* i_data, std::size_t i_size)
+{
+    Sha1 sha1;
+    sha1.update(i_data, i_size);
+    return sha1.finalize();
+}
+
+Digest compute(Kernel i_kernel, const char* i_data, std::size_t i_size)
+{
+    Sha1 sha1(i_kernel);
+    sha1.update(i_data, i_size);
+    return sha1.finalize();
+}
+
+bool is_kernel_available(Kernel i_kernel)
+{
+    switch (i_kernel)
+    {
+    case Kernel::portable:
+        return true;
+
+#ifdef XIV_SHA1_X86
+    case Kernel::sha_ni:
+        return internal::has_sha_ni();
+#endif
+
+    default:
+        return false;
+    }
+}
+
+}
+}
+}
@@ -18,6 +18,12 @@ std::unique_ptr<std::basic_istream<char>> get_istream(const std::vector<char>& i
                new boost::iostreams::stream<boost::iostreams::basic_array_source<char>>(i_source.data(), i_source.size()));
 }
 
+std::unique_ptr<std::basic_istream<char>> get_istream(const char* i_data, std::size_t i_size)
+{
+    return std::unique_ptr<std::basic_istream<char>>(
+               new boost::iostreams::stream<boost::iostreams::basic_array_source<char>>(i_data, i_size));
+}
+
 std::unique_ptr<std::basic_ostream<char>> get_ostream(std::vector<char>& i_source)
 {
     return std::unique_ptr<std::basic_ostream<char>>(
@@ -0,0 +1,161 @@
+#include <xiv/utils/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <exception>
+
+namespace
+{
+// State shared by the caller and the workers of a parallel_for, workers can start after the caller returned so it is refcounted
+struct ParallelForState
+{
+    ParallelForState(uint32_t i_count, const std::function<void(uint32_t)>& i_task) :
+        count(i_count),
+        task(i_task),
+        next_index(0),
+        done_count(0)
+    {
+    }
+
+    // Claims and runs indices until there are none left
+    void run()
+    {
+        uint32_t index;
+        while ((index = next_index++) < count)
+        {
+            try
+            {
+                task(index);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!exception)
+                {
+                    exception = std::current_exception();
+                }
+            }
+
+            if (++done_count == count)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done_cv.notify_all();
+            }
+        }
+    }
+
+    const uint32_t count;
+    // Only valid while the caller waits, which is always the case while an index can still be claimed
+    const std::function<void(uint32_t)>& task;
+    std::atomic<uint32_t> next_index;
+    std::atomic<uint32_t> done_count;
+
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::exception_ptr exception;
+};
+}
+
+namespace xiv
+{
+namespace utils
+{
+namespace thread_pool
+{
+
+ThreadPool::ThreadPool(uint32_t i_thread_count) :
+    _stopping(false)
+{
+    if (i_thread_count == 0)
+    {
+        i_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (uint32_t i = 0; i < i_thread_count; ++i)
+    {
+        _threads.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_tasks_mutex);
+        _stopping = true;
+    }
+    _tasks_cv.notify_all();
+
+    for (auto& thread: _threads)
+    {
+        thread.join();
+    }
+}
+
+uint32_t ThreadPool::get_thread_count() const
+{
+    return _threads.size();
+}
+
+void ThreadPool::push(std::function<void()> i_task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_tasks_mutex);
+        _tasks.push(std::move(i_task));
+    }
+    _tasks_cv.notify_one();
+}
+
+void ThreadPool::parallel_for(uint32_t i_count, const std::function<void(uint32_t)>& i_task)
+{
+    if (i_count == 0)
+    {
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>(i_count, i_task);
+
+    // One helper per worker at most, the caller is the last one
+    const uint32_t helper_count = std::min<uint32_t>(get_thread_count(), i_count - 1);
+    for (uint32_t i = 0; i < helper_count; ++i)
+    {
+        push([state] { state->run(); });
+    }
+
+    state->run();
+
+    // All the indices are claimed at this point, only wait for the ones still running on workers
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done_cv.wait(lock, [&state] { return state->done_count == state->count; });
+    }
+
+    if (state->exception)
+    {
+        std::rethrow_exception(state->exception);
+    }
+}
+
+void ThreadPool::work()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_tasks_mutex);
+            _tasks_cv.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+            if (_tasks.empty())
+            {
+                // Stopping and nothing left to do
+                return;
+            }
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+        task();
+    }
+}
+
+}
+}
+}
@@ -4,6 +4,10 @@
 
 #include <zlib.h>
 
+#ifdef XIV_USE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
 namespace xiv
 {
 namespace utils
@@ -28,36 +32,143 @@ void compress(const std::vector<char>& in, std::vector<char>& out)
     out.resize(out_size);
 }
 
-void no_header_decompress(uint8_t* in, uint32_t in_size, uint8_t* out, uint32_t out_size)
+void no_header_decompress(const uint8_t* in, uint32_t in_size, uint8_t* out, uint32_t out_size)
 {
-    z_stream strm;
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = in_size;
-    strm.next_in = Z_NULL;
-
-    // Init with -15 because we do not have header in this compressed data
-    auto ret = inflateInit2(&strm, -15);
-    if (ret != Z_OK)
+    // Blocks are small (16KB max uncompressed) so setting up the decoder would cost as much as decoding, keep one per thread
+    thread_local Decompressor decompressor;
+    decompressor.no_header_decompress(in, in_size, out, out_size);
+}
+
+bool is_backend_available(Backend i_backend)
+{
+    switch (i_backend)
+    {
+    case Backend::zlib:
+        return true;
+
+    case Backend::libdeflate:
+#ifdef XIV_USE_LIBDEFLATE
+        return true;
+#else
+        return false;
+#endif
+
+    default:
+        return false;
+    }
+}
+
+Backend get_default_backend()
+{
+#ifdef XIV_USE_LIBDEFLATE
+    return Backend::libdeflate;
+#else
+    return Backend::zlib;
+#endif
+}
+
+Decompressor::Decompressor(Backend i_backend) :
+    _backend(i_backend),
+    _state(nullptr)
+{
+    if (!is_backend_available(_backend))
     {
-        throw std::runtime_error("Error at zlib init: " + std::to_string(ret));
+        throw std::runtime_error("zlib backend not built in: " + std::to_string(static_cast<uint32_t>(_backend)));
     }
 
-    // Set pointers to the right addresses
-    strm.next_in = in;
-    strm.avail_out = out_size;
-    strm.next_out = out;
+    if (_backend == Backend::zlib)
+    {
+        auto strm = new z_stream();
+        strm->zalloc = Z_NULL;
+        strm->zfree = Z_NULL;
+        strm->opaque = Z_NULL;
+        strm->avail_in = 0;
+        strm->next_in = Z_NULL;
+
+        // Init with -15 because we do not have header in this compressed data
+        auto ret = inflateInit2(strm, -15);
+        if (ret != Z_OK)
+        {
+            delete strm;
+            throw std::runtime_error("Error at zlib init: " + std::to_string(ret));
+        }
+        _state = strm;
+    }
+#ifdef XIV_USE_LIBDEFLATE
+    else
+    {
+        _state = libdeflate_alloc_decompressor();
+        if (!_state)
+        {
+            throw std::runtime_error("Error at libdeflate init");
+        }
+    }
+#endif
+}
 
-    // Effectively decompress data
-    ret = inflate(&strm, Z_NO_FLUSH);
-    if (ret != Z_STREAM_END)
+Decompressor::~Decompressor()
+{
+    if (_backend == Backend::zlib)
     {
-        throw std::runtime_error("Error at zlib inflate: " + std::to_string(ret));
+        auto strm = static_cast<z_stream*>(_state);
+        inflateEnd(strm);
+        delete strm;
     }
+#ifdef XIV_USE_LIBDEFLATE
+    else
+    {
+        libdeflate_free_decompressor(static_cast<libdeflate_decompressor*>(_state));
+    }
+#endif
+}
+
+Backend Decompressor::get_backend() const
+{
+    return _backend;
+}
+
+void Decompressor::no_header_decompress(const uint8_t* in, uint32_t in_size, uint8_t* out, uint32_t out_size)
+{
+    if (_backend == Backend::zlib)
+    {
+        auto strm = static_cast<z_stream*>(_state);
+
+        // Only reset the state, the window and tables allocated at init are kept
+        auto ret = inflateReset(strm);
+        if (ret != Z_OK)
+        {
+            throw std::runtime_error("Error at zlib reset: " + std::to_string(ret));
+        }
 
-    // Clean up
-    inflateEnd(&strm);
+        // Set pointers to the right addresses
+        strm->next_in = const_cast<uint8_t*>(in);
+        strm->avail_in = in_size;
+        strm->next_out = out;
+        strm->avail_out = out_size;
+
+        // Effectively decompress data
+        ret = inflate(strm, Z_FINISH);
+        if (ret != Z_STREAM_END)
+        {
+            throw std::runtime_error("Error at zlib inflate: " + std::to_string(ret));
+        }
+        // A stream shorter than out_size still ends with Z_STREAM_END, it is as invalid as for libdeflate
+        if (strm->avail_out != 0)
+        {
+            throw std::runtime_error("Error at zlib inflate: " + std::to_string(strm->avail_out) + " bytes missing");
+        }
+    }
+#ifdef XIV_USE_LIBDEFLATE
+    else
+    {
+        // One shot, the whole input and output buffers are known
+        auto ret = libdeflate_deflate_decompress(static_cast<libdeflate_decompressor*>(_state), in, in_size, out, out_size, nullptr);
+        if (ret != LIBDEFLATE_SUCCESS)
+        {
+            throw std::runtime_error("Error at libdeflate decompress: " + std::to_string(static_cast<int>(ret)));
+        }
+    }
+#endif
 }
 
 }
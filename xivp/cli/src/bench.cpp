@@ -0,0 +1,964 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <mutex>
+#include <queue>
+#include <functional>
+#include <cstring>
+
+#include <boost/format.hpp>
+
+#include <xiv/utils/thread_pool.h>
+#include <xiv/utils/work_queue.h>
+#include <xiv/utils/zlib.h>
+#include <xiv/utils/crc32.h>
+#include <xiv/utils/sha1.h>
+
+#include <xiv/dat/GameData.h>
+#include <xiv/dat/PathHash.h>
+#include <xiv/dat/File.h>
+#include <xiv/dat/Cat.h>
+#include <xiv/dat/Index.h>
+#include <xiv/dat/Dat.h>
+
+// Benchmarks of the dat reading paths, results are printed on stdout
+
+namespace
+{
+typedef std::chrono::high_resolution_clock bench_clock;
+
+double elapsed_seconds(const bench_clock::time_point& i_start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - i_start).count();
+}
+
+// Bytes currently allocated through CountingAllocator
+std::size_t counted_bytes = 0;
+
+// Allocator that keeps track of the memory used by a std container
+template <typename T>
+struct CountingAllocator
+{
+    typedef T value_type;
+
+    CountingAllocator() {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+
+    T* allocate(std::size_t i_count)
+    {
+        counted_bytes += i_count * sizeof(T);
+        return static_cast<T*>(::operator new(i_count * sizeof(T)));
+    }
+    void deallocate(T* i_ptr, std::size_t i_count)
+    {
+        counted_bytes -= i_count * sizeof(T);
+        ::operator delete(i_ptr);
+    }
+};
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) { return false; }
+
+// Keeps the buffers of destroyed files in free lists by power of 2 size, so that they are reused by the next files
+class RecyclingFileAllocator : public xiv::dat::FileAllocator
+{
+public:
+    ~RecyclingFileAllocator()
+    {
+        for (auto& free_list: _free_lists)
+        {
+            for (auto data: free_list.second)
+            {
+                delete[] data;
+            }
+        }
+    }
+
+    char* allocate(std::size_t i_size)
+    {
+        const std::size_t capacity = get_capacity(i_size);
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto& free_list = _free_lists[capacity];
+        if (free_list.empty())
+        {
+            return new char[capacity];
+        }
+        char* data = free_list.back();
+        free_list.pop_back();
+        return data;
+    }
+
+    void deallocate(char* i_data, std::size_t i_size)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free_lists[get_capacity(i_size)].push_back(i_data);
+    }
+
+protected:
+    static std::size_t get_capacity(std::size_t i_size)
+    {
+        std::size_t capacity = 4096;
+        while (capacity < i_size)
+        {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    std::mutex _mutex;
+    std::unordered_map<std::size_t, std::vector<char*>> _free_lists;
+};
+
+uint64_t get_file_size(const xiv::dat::File& i_file)
+{
+    return i_file.get_size();
+}
+}
+
+// Reads the same set of files from a single .dat with 1 to N threads
+void bench_dat_scaling(xiv::dat::GameData& i_game_data)
+{
+    const uint32_t max_file_count = 5000;
+
+    // Only take files from chara dat0 so that all the threads hit the same dat
+    auto& cat = i_game_data.get_category("chara");
+    std::vector<xiv::dat::Index::HashTableEntry> entries;
+    for (auto& entry: cat.get_index().get_entries())
+    {
+        if (entry.dat_nb == 0 && entries.size() < max_file_count)
+        {
+            entries.push_back(entry);
+        }
+    }
+
+    std::cout << "bench_dat_scaling: " << entries.size() << " files from " << cat.get_name() << " dat0" << std::endl;
+
+    for (uint32_t thread_count = 1; thread_count <= std::thread::hardware_concurrency(); ++thread_count)
+    {
+        std::atomic<uint64_t> total_size(0);
+        std::vector<std::thread> threads;
+
+        auto start = bench_clock::now();
+        for (uint32_t t = 0; t < thread_count; ++t)
+        {
+            threads.emplace_back([&, t] {
+                uint64_t size = 0;
+                // Interleave the files between threads so that they all read the same areas of the dat
+                for (uint32_t i = t; i < entries.size(); i += thread_count)
+                {
+                    auto file = cat.get_file(entries[i].dir_hash, entries[i].filename_hash);
+                    size += get_file_size(*file);
+                }
+                total_size += size;
+            });
+        }
+        for (auto& thread: threads)
+        {
+            thread.join();
+        }
+        auto seconds = elapsed_seconds(start);
+
+        std::cout << std::setw(3) << thread_count << " threads: "
+                  << std::fixed << std::setprecision(3) << seconds << "s - "
+                  << std::setprecision(1) << entries.size() / seconds << " files/s - "
+                  << total_size / seconds / (1024 * 1024) << " MB/s" << std::endl;
+    }
+}
+
+// Decodes the biggest files of chara one at a time, with and without spreading their blocks on a pool
+void bench_parallel_decode(const boost::filesystem::path& i_path)
+{
+    const uint32_t scanned_file_count = 5000;
+    const uint32_t big_file_count = 50;
+    const uint32_t repeat_count = 5;
+
+    xiv::utils::thread_pool::ThreadPool decode_pool;
+    xiv::dat::Options parallel_options;
+    parallel_options.decode_pool = &decode_pool;
+
+    xiv::dat::GameData serial_game_data(i_path);
+    xiv::dat::GameData parallel_game_data(i_path, parallel_options);
+
+    // Find the biggest files among the first ones of the index
+    auto& serial_cat = serial_game_data.get_category("chara");
+    std::vector<std::pair<uint64_t, xiv::dat::Index::HashTableEntry>> sized_entries;
+    for (auto& entry: serial_cat.get_index().get_entries())
+    {
+        if (sized_entries.size() < scanned_file_count)
+        {
+            auto file = serial_cat.get_file(entry.dir_hash, entry.filename_hash);
+            sized_entries.emplace_back(get_file_size(*file), entry);
+        }
+    }
+    std::sort(sized_entries.begin(), sized_entries.end(),
+              [](const std::pair<uint64_t, xiv::dat::Index::HashTableEntry>& i_lhs, const std::pair<uint64_t, xiv::dat::Index::HashTableEntry>& i_rhs) {
+                  return i_lhs.first > i_rhs.first;
+              });
+    sized_entries.resize(std::min<std::size_t>(sized_entries.size(), big_file_count));
+
+    uint64_t total_size = 0;
+    for (auto& sized_entry: sized_entries)
+    {
+        total_size += sized_entry.first;
+    }
+    std::cout << "bench_parallel_decode: " << sized_entries.size() << " files - " << total_size / (1024 * 1024) << " MB - "
+              << decode_pool.get_thread_count() << " decode threads" << std::endl;
+
+    xiv::dat::GameData* game_datas[] = { &serial_game_data, &parallel_game_data };
+    const char* names[] = { "serial", "parallel" };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        auto& cat = game_datas[i]->get_category("chara");
+        auto start = bench_clock::now();
+        for (uint32_t r = 0; r < repeat_count; ++r)
+        {
+            for (auto& sized_entry: sized_entries)
+            {
+                cat.get_file(sized_entry.second.dir_hash, sized_entry.second.filename_hash);
+            }
+        }
+        auto seconds = elapsed_seconds(start);
+
+        std::cout << std::setw(9) << names[i] << ": " << std::fixed << std::setprecision(3) << seconds / repeat_count << "s per pass - "
+                  << std::setprecision(1) << repeat_count * total_size / seconds / (1024 * 1024) << " MB/s" << std::endl;
+    }
+}
+
+// Decompresses real blocks from chara with a fresh decoder per block, a reused zlib decoder and libdeflate if built in
+void bench_decompress(xiv::dat::GameData& i_game_data)
+{
+    const uint32_t max_file_count = 2000;
+    const uint32_t repeat_count = 5;
+
+    // A compressed block copied out of the dat
+    struct CompressedBlock
+    {
+        std::vector<uint8_t> data;
+        uint32_t uncompressed_size;
+    };
+
+    // Collect the compressed blocks of the first files of the index, so that sizes follow the real distribution
+    auto& cat = i_game_data.get_category("chara");
+    std::vector<CompressedBlock> blocks;
+    uint32_t file_count = 0;
+    for (auto& entry: cat.get_index().get_entries())
+    {
+        if (file_count >= max_file_count)
+        {
+            break;
+        }
+        ++file_count;
+
+        auto& dat = cat.get_dat(entry.dat_nb);
+        xiv::dat::Dat::FileLayout layout;
+        dat.get_file_layout(entry.dat_offset, layout);
+        for (uint32_t i = 0; i < layout.section_block_offsets.size(); ++i)
+        {
+            std::vector<char> buffer;
+            std::vector<xiv::dat::Dat::BlockView> block_views;
+            dat.gather_blocks(layout.section_block_offsets[i], layout.section_end_offsets[i], buffer, block_views);
+            for (auto& block_view: block_views)
+            {
+                if (block_view.is_compressed)
+                {
+                    CompressedBlock block;
+                    block.data.assign(block_view.data, block_view.data + block_view.size);
+                    block.uncompressed_size = block_view.uncompressed_size;
+                    blocks.push_back(std::move(block));
+                }
+            }
+        }
+    }
+
+    // Distribution of the uncompressed sizes, by 2KB buckets
+    const uint32_t bucket_size = 2048;
+    std::vector<uint32_t> buckets(16000 / bucket_size + 1);
+    uint64_t total_size = 0;
+    uint64_t total_compressed_size = 0;
+    uint32_t max_uncompressed_size = 0;
+    for (auto& block: blocks)
+    {
+        ++buckets[std::min<std::size_t>(block.uncompressed_size / bucket_size, buckets.size() - 1)];
+        total_size += block.uncompressed_size;
+        total_compressed_size += block.data.size();
+        max_uncompressed_size = std::max(max_uncompressed_size, block.uncompressed_size);
+    }
+
+    std::cout << "bench_decompress: " << blocks.size() << " compressed blocks from " << file_count << " files - "
+              << total_compressed_size / 1024 << " KB -> " << total_size / 1024 << " KB" << std::endl;
+    for (uint32_t i = 0; i < buckets.size(); ++i)
+    {
+        std::cout << std::setw(6) << i * bucket_size / 1024 << "KB+: " << buckets[i] << std::endl;
+    }
+
+    std::vector<uint8_t> output(max_uncompressed_size);
+
+    auto print_result = [&](const char* i_name, double i_seconds) {
+        std::cout << std::setw(12) << i_name << ": " << std::fixed << std::setprecision(3) << i_seconds / repeat_count << "s per pass - "
+                  << std::setprecision(1) << repeat_count * blocks.size() / i_seconds << " blocks/s - "
+                  << repeat_count * total_size / i_seconds / (1024 * 1024) << " MB/s" << std::endl;
+    };
+
+    // Fresh decoder for every block: what every block cost before decoders were reused
+    {
+        auto start = bench_clock::now();
+        for (uint32_t r = 0; r < repeat_count; ++r)
+        {
+            for (auto& block: blocks)
+            {
+                xiv::utils::zlib::Decompressor decompressor(xiv::utils::zlib::Backend::zlib);
+                decompressor.no_header_decompress(block.data.data(), block.data.size(), output.data(), block.uncompressed_size);
+            }
+        }
+        print_result("zlib fresh", elapsed_seconds(start));
+    }
+
+    // One decoder per backend, only reset between blocks
+    const xiv::utils::zlib::Backend backends[] = { xiv::utils::zlib::Backend::zlib, xiv::utils::zlib::Backend::libdeflate };
+    const char* names[] = { "zlib reused", "libdeflate" };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        if (!xiv::utils::zlib::is_backend_available(backends[i]))
+        {
+            std::cout << std::setw(12) << names[i] << ": not built in" << std::endl;
+            continue;
+        }
+
+        xiv::utils::zlib::Decompressor decompressor(backends[i]);
+        auto start = bench_clock::now();
+        for (uint32_t r = 0; r < repeat_count; ++r)
+        {
+            for (auto& block: blocks)
+            {
+                decompressor.no_header_decompress(block.data.data(), block.data.size(), output.data(), block.uncompressed_size);
+            }
+        }
+        print_result(names[i], elapsed_seconds(start));
+    }
+}
+
+// Memory and lookup latency of the flat Index against the nested unordered_maps it replaced, on every category
+void bench_index(xiv::dat::GameData& i_game_data)
+{
+    const uint32_t lookup_count = 4000000;
+
+    typedef xiv::dat::Index::HashTableEntry HashTableEntry;
+    typedef std::unordered_map<uint32_t, HashTableEntry, std::hash<uint32_t>, std::equal_to<uint32_t>,
+                               CountingAllocator<std::pair<const uint32_t, HashTableEntry>>> DirHashTable;
+    typedef std::unordered_map<uint32_t, DirHashTable, std::hash<uint32_t>, std::equal_to<uint32_t>,
+                               CountingAllocator<std::pair<const uint32_t, DirHashTable>>> HashTable;
+
+    std::mt19937 generator(42);
+
+    for (auto cat_nb: i_game_data.get_cat_nbs())
+    {
+        auto& index = i_game_data.get_category(cat_nb).get_index();
+        auto& entries = index.get_entries();
+        if (entries.empty())
+        {
+            continue;
+        }
+
+        // Same content as the flat tables
+        counted_bytes = 0;
+        HashTable hash_table;
+        for (auto& entry: entries)
+        {
+            hash_table[entry.dir_hash][entry.filename_hash] = entry;
+        }
+        const std::size_t nested_bytes = counted_bytes;
+
+        // Half hits, half misses on the filename
+        std::vector<std::pair<uint32_t, uint32_t>> probes(lookup_count);
+        std::uniform_int_distribution<uint32_t> entry_distribution(0, entries.size() - 1);
+        for (uint32_t i = 0; i < lookup_count; ++i)
+        {
+            auto& entry = entries[entry_distribution(generator)];
+            probes[i] = std::make_pair(entry.dir_hash, (i % 2) ? entry.filename_hash : entry.filename_hash ^ generator());
+        }
+
+        uint32_t nested_found = 0;
+        auto start = bench_clock::now();
+        for (auto& probe: probes)
+        {
+            auto dir_it = hash_table.find(probe.first);
+            if (dir_it != hash_table.end() && dir_it->second.find(probe.second) != dir_it->second.end())
+            {
+                ++nested_found;
+            }
+        }
+        auto nested_seconds = elapsed_seconds(start);
+
+        uint32_t flat_found = 0;
+        start = bench_clock::now();
+        for (auto& probe: probes)
+        {
+            if (index.check_file_existence(probe.first, probe.second))
+            {
+                ++flat_found;
+            }
+        }
+        auto flat_seconds = elapsed_seconds(start);
+
+        if (nested_found != flat_found)
+        {
+            throw std::runtime_error("bench_index: lookups do not match");
+        }
+
+        std::cout << "bench_index: cat " << std::hex << std::setw(2) << std::setfill('0') << cat_nb << std::dec << std::setfill(' ') << " - "
+                  << entries.size() << " files - " << index.get_dirs().size() << " dirs" << std::endl;
+        std::cout << "    nested: " << nested_bytes / 1024 << " KB - " << std::fixed << std::setprecision(1)
+                  << nested_seconds * 1e9 / lookup_count << " ns/lookup" << std::endl;
+        std::cout << "      flat: " << index.get_memory_usage() / 1024 << " KB - "
+                  << flat_seconds * 1e9 / lookup_count << " ns/lookup" << std::endl;
+    }
+}
+
+// Opens every category of a fresh GameData: without index cache, while writing the cache, then from the cache
+void bench_index_cache(const boost::filesystem::path& i_path)
+{
+    const auto cache_path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("xiv_index_cache_%%%%-%%%%");
+
+    xiv::dat::Options cache_options;
+    cache_options.index_cache_path = cache_path;
+
+    const xiv::dat::Options* options[] = { nullptr, &cache_options, &cache_options };
+    const char* names[] = { "no cache", "cache write", "cache read" };
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        auto start = bench_clock::now();
+        xiv::dat::GameData game_data(i_path, options[i] ? *options[i] : xiv::dat::Options());
+        uint64_t entry_count = 0;
+        for (auto cat_nb: game_data.get_cat_nbs())
+        {
+            entry_count += game_data.get_category(cat_nb).get_index().get_entries().size();
+        }
+        auto seconds = elapsed_seconds(start);
+
+        std::cout << "bench_index_cache: " << std::setw(11) << names[i] << ": " << std::fixed << std::setprecision(1)
+                  << seconds * 1000 << "ms - " << entry_count << " entries" << std::endl;
+    }
+
+    boost::filesystem::remove_all(cache_path);
+}
+
+// Reads the same files of chara in random order, one get_file at a time then as one get_files batch
+void bench_get_files(xiv::dat::GameData& i_game_data)
+{
+    const uint32_t file_count = 5000;
+
+    auto& cat = i_game_data.get_category("chara");
+    std::vector<xiv::dat::Index::HashTableEntry> entries(cat.get_index().get_entries());
+    std::shuffle(entries.begin(), entries.end(), std::mt19937(42));
+    entries.resize(std::min<std::size_t>(entries.size(), file_count));
+
+    std::vector<std::pair<uint32_t, uint32_t>> hashes;
+    for (auto& entry: entries)
+    {
+        hashes.emplace_back(entry.dir_hash, entry.filename_hash);
+    }
+
+    std::cout << "bench_get_files: " << hashes.size() << " files from " << cat.get_name() << " in random order" << std::endl;
+
+    uint64_t total_size = 0;
+    auto start = bench_clock::now();
+    for (auto& hash: hashes)
+    {
+        total_size += get_file_size(*cat.get_file(hash.first, hash.second));
+    }
+    auto seconds = elapsed_seconds(start);
+    std::cout << "  get_file: " << std::fixed << std::setprecision(3) << seconds << "s - "
+              << std::setprecision(1) << total_size / seconds / (1024 * 1024) << " MB/s" << std::endl;
+
+    total_size = 0;
+    start = bench_clock::now();
+    cat.get_files(hashes, [&total_size](uint32_t, std::unique_ptr<xiv::dat::File> i_file) {
+        total_size += get_file_size(*i_file);
+    });
+    seconds = elapsed_seconds(start);
+    std::cout << " get_files: " << std::fixed << std::setprecision(3) << seconds << "s - "
+              << std::setprecision(1) << total_size / seconds / (1024 * 1024) << " MB/s" << std::endl;
+}
+
+// Reads the biggest files of music whole with get_file then streamed with stream_file
+void bench_stream_file(xiv::dat::GameData& i_game_data)
+{
+    const uint32_t big_file_count = 20;
+
+    // Sizes from the layouts, nothing is decoded
+    auto& cat = i_game_data.get_category("music");
+    std::vector<std::pair<uint32_t, xiv::dat::Index::HashTableEntry>> sized_entries;
+    for (auto& entry: cat.get_index().get_entries())
+    {
+        xiv::dat::Dat::FileLayout layout;
+        cat.get_dat(entry.dat_nb).get_file_layout(entry.dat_offset, layout);
+        sized_entries.emplace_back(layout.end_offset - layout.offset, entry);
+    }
+    std::sort(sized_entries.begin(), sized_entries.end(),
+              [](const std::pair<uint32_t, xiv::dat::Index::HashTableEntry>& i_lhs, const std::pair<uint32_t, xiv::dat::Index::HashTableEntry>& i_rhs) {
+                  return i_lhs.first > i_rhs.first;
+              });
+    sized_entries.resize(std::min<std::size_t>(sized_entries.size(), big_file_count));
+
+    // Whole files: peak memory is the biggest file
+    uint64_t total_size = 0;
+    uint64_t max_file_size = 0;
+    auto start = bench_clock::now();
+    for (auto& sized_entry: sized_entries)
+    {
+        auto file_size = get_file_size(*cat.get_file(sized_entry.second.dir_hash, sized_entry.second.filename_hash));
+        total_size += file_size;
+        max_file_size = std::max(max_file_size, file_size);
+    }
+    auto seconds = elapsed_seconds(start);
+    std::cout << "bench_stream_file: " << sized_entries.size() << " files - " << total_size / (1024 * 1024) << " MB" << std::endl;
+    std::cout << "   get_file: " << std::fixed << std::setprecision(3) << seconds << "s - " << std::setprecision(1)
+              << total_size / seconds / (1024 * 1024) << " MB/s - biggest buffer: " << max_file_size / 1024 << " KB" << std::endl;
+
+    // Streamed: peak memory is two chunks of raw blocks and one decompressed block
+    total_size = 0;
+    uint32_t max_block_size = 0;
+    start = bench_clock::now();
+    for (auto& sized_entry: sized_entries)
+    {
+        cat.stream_file(sized_entry.second.dir_hash, sized_entry.second.filename_hash,
+                        [&total_size, &max_block_size](uint32_t, const char*, uint32_t i_size) {
+                            total_size += i_size;
+                            max_block_size = std::max(max_block_size, i_size);
+                        });
+    }
+    seconds = elapsed_seconds(start);
+    std::cout << "stream_file: " << std::fixed << std::setprecision(3) << seconds << "s - " << std::setprecision(1)
+              << total_size / seconds / (1024 * 1024) << " MB/s - biggest block: " << max_block_size / 1024 << " KB" << std::endl;
+}
+
+// Reads the same files of chara with files allocated by new[] then from a RecyclingFileAllocator
+void bench_file_allocation(const boost::filesystem::path& i_path)
+{
+    const uint32_t file_count = 20000;
+    const uint32_t repeat_count = 3;
+
+    RecyclingFileAllocator file_allocator;
+    xiv::dat::Options recycling_options;
+    recycling_options.file_allocator = &file_allocator;
+
+    xiv::dat::GameData default_game_data(i_path);
+    xiv::dat::GameData recycling_game_data(i_path, recycling_options);
+
+    std::vector<xiv::dat::Index::HashTableEntry> entries(default_game_data.get_category("chara").get_index().get_entries());
+    entries.resize(std::min<std::size_t>(entries.size(), file_count));
+
+    std::cout << "bench_file_allocation: " << entries.size() << " files from chara" << std::endl;
+
+    xiv::dat::GameData* game_datas[] = { &default_game_data, &recycling_game_data };
+    const char* names[] = { "new[]", "recycling" };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        auto& cat = game_datas[i]->get_category("chara");
+        uint64_t total_size = 0;
+        auto start = bench_clock::now();
+        for (uint32_t r = 0; r < repeat_count; ++r)
+        {
+            for (auto& entry: entries)
+            {
+                total_size += get_file_size(*cat.get_file(entry.dir_hash, entry.filename_hash));
+            }
+        }
+        auto seconds = elapsed_seconds(start);
+
+        std::cout << std::setw(10) << names[i] << ": " << std::fixed << std::setprecision(3) << seconds / repeat_count << "s per pass - "
+                  << std::setprecision(1) << repeat_count * entries.size() / seconds << " files/s - "
+                  << total_size / seconds / (1024 * 1024) << " MB/s" << std::endl;
+    }
+}
+
+// Opens all the categories one after the other on first use, then all at once in the GameData constructor
+// Then measures the lookup of an already opened category
+void bench_open_categories(const boost::filesystem::path& i_path)
+{
+    const uint32_t lookup_count = 10000000;
+
+    xiv::dat::Options eager_options;
+    eager_options.open_all_categories = true;
+
+    auto start = bench_clock::now();
+    xiv::dat::GameData lazy_game_data(i_path);
+    for (auto cat_nb: lazy_game_data.get_cat_nbs())
+    {
+        lazy_game_data.get_category(cat_nb);
+    }
+    auto lazy_seconds = elapsed_seconds(start);
+
+    start = bench_clock::now();
+    xiv::dat::GameData eager_game_data(i_path, eager_options);
+    auto eager_seconds = elapsed_seconds(start);
+
+    std::cout << "bench_open_categories: " << lazy_game_data.get_cat_nbs().size() << " categories" << std::endl;
+    std::cout << "  sequential: " << std::fixed << std::setprecision(1) << lazy_seconds * 1000 << "ms" << std::endl;
+    std::cout << "    parallel: " << eager_seconds * 1000 << "ms" << std::endl;
+
+    auto& cat_nbs = eager_game_data.get_cat_nbs();
+    uint64_t checksum = 0;
+    start = bench_clock::now();
+    for (uint32_t i = 0; i < lookup_count; ++i)
+    {
+        checksum += eager_game_data.get_category(cat_nbs[i % cat_nbs.size()]).get_nb();
+    }
+    auto lookup_seconds = elapsed_seconds(start);
+    std::cout << "      lookup: " << std::setprecision(2) << lookup_seconds * 1e9 / lookup_count << " ns - checksum " << checksum << std::endl;
+}
+
+// Checks the existence of the same equipment model paths from strings, from PathHashes built each time, and from PathHashes built once
+void bench_path_hash(xiv::dat::GameData& i_game_data)
+{
+    const uint32_t repeat_count = 20;
+
+    std::vector<std::string> paths;
+    for (uint32_t e = 0; e < 10000; ++e)
+    {
+        paths.push_back(boost::str(boost::format("chara/equipment/e%04d/model/c0101e%04d_top.mdl") % e % e));
+    }
+    std::vector<xiv::dat::PathHash> path_hashes;
+    for (auto& path: paths)
+    {
+        path_hashes.emplace_back(path);
+    }
+
+    // Open the category before timing
+    i_game_data.get_category("chara");
+
+    uint32_t found_counts[3] = { 0, 0, 0 };
+    double seconds[3];
+
+    auto start = bench_clock::now();
+    for (uint32_t r = 0; r < repeat_count; ++r)
+    {
+        for (auto& path: paths)
+        {
+            found_counts[0] += i_game_data.check_file_existence(path);
+        }
+    }
+    seconds[0] = elapsed_seconds(start);
+
+    start = bench_clock::now();
+    for (uint32_t r = 0; r < repeat_count; ++r)
+    {
+        for (auto& path: paths)
+        {
+            found_counts[1] += i_game_data.check_file_existence(xiv::dat::PathHash(path));
+        }
+    }
+    seconds[1] = elapsed_seconds(start);
+
+    start = bench_clock::now();
+    for (uint32_t r = 0; r < repeat_count; ++r)
+    {
+        for (auto& path_hash: path_hashes)
+        {
+            found_counts[2] += i_game_data.check_file_existence(path_hash);
+        }
+    }
+    seconds[2] = elapsed_seconds(start);
+
+    std::cout << "bench_path_hash: " << paths.size() << " paths - " << found_counts[2] / repeat_count << " found" << std::endl;
+    const char* names[] = { "string", "hashed each time", "hashed once" };
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        std::cout << std::setw(16) << names[i] << ": " << std::fixed << std::setprecision(1)
+                  << seconds[i] * 1e9 / (repeat_count * paths.size()) << " ns/lookup" << std::endl;
+    }
+
+    // A runtime buffer bigger than its content goes through the array overload too, it must hash like the literal
+    char path_buffer[64] = {};
+    std::strcpy(path_buffer, "exd/root.exl");
+    const xiv::dat::PathHash buffer_hash(path_buffer);
+    const xiv::dat::PathHash literal_hash("exd/root.exl");
+    std::cout << std::setw(16) << "char buffer" << ": "
+              << ((buffer_hash.get_dir_hash() == literal_hash.get_dir_hash() && buffer_hash.get_filename_hash() == literal_hash.get_filename_hash()) ? "same as literal" : "MISMATCH")
+              << std::endl;
+}
+
+// crc32 kernels on typical dat paths (20 to 60 chars) and on a large buffer
+void bench_crc32()
+{
+    const uint32_t path_count = 100000;
+    const uint32_t repeat_count = 20;
+
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<uint32_t> size_dist(20, 60);
+    std::uniform_int_distribution<uint32_t> char_dist(0, 36);
+    const char* chars = "abcdefghijklmnopqrstuvwxyz0123456789_/";
+    std::vector<std::string> paths(path_count);
+    std::size_t total_size = 0;
+    for (auto& path: paths)
+    {
+        path.resize(size_dist(rng));
+        for (auto& c: path)
+        {
+            c = chars[char_dist(rng)];
+        }
+        // Always at least a dir and a filename
+        path[path.size() / 2] = '/';
+        total_size += path.size();
+    }
+    std::vector<char> buffer(0x1000000);
+    for (auto& c: buffer)
+    {
+        c = static_cast<char>(rng());
+    }
+
+    std::cout << "bench_crc32: " << path_count << " paths - " << total_size / path_count << " bytes on average" << std::endl;
+
+    const xiv::utils::crc32::Kernel kernels[] = { xiv::utils::crc32::Kernel::table, xiv::utils::crc32::Kernel::slicing_by_16, xiv::utils::crc32::Kernel::pclmul };
+    const char* names[] = { "table", "slicing_by_16", "pclmul" };
+    uint32_t reference_crc = 0;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        if (!xiv::utils::crc32::is_kernel_available(kernels[i]))
+        {
+            std::cout << std::setw(16) << names[i] << ": not available" << std::endl;
+            continue;
+        }
+
+        uint32_t crc = 0;
+        auto start = bench_clock::now();
+        for (uint32_t r = 0; r < repeat_count; ++r)
+        {
+            for (auto& path: paths)
+            {
+                crc ^= xiv::utils::crc32::update(kernels[i], 0xFFFFFFFF, path.data(), path.size());
+            }
+        }
+        const double path_seconds = elapsed_seconds(start);
+
+        start = bench_clock::now();
+        crc ^= xiv::utils::crc32::update(kernels[i], 0xFFFFFFFF, buffer.data(), buffer.size());
+        const double buffer_seconds = elapsed_seconds(start);
+
+        if (i == 0)
+        {
+            reference_crc = crc;
+        }
+        std::cout << std::setw(16) << names[i] << ": " << std::fixed << std::setprecision(1)
+                  << path_seconds * 1e9 / (repeat_count * path_count) << " ns/path - "
+                  << std::setprecision(2) << buffer.size() / buffer_seconds / 1e9 << " GB/s on 16MB"
+                  << (crc == reference_crc ? "" : " - MISMATCH") << std::endl;
+    }
+
+    // Whole path hashing as done by the lookups: lowercasing, both crcs and the category
+    for (auto& path: paths)
+    {
+        path.replace(0, path.find('/'), "chara");
+    }
+    uint32_t hash_xor = 0;
+    auto start = bench_clock::now();
+    for (uint32_t r = 0; r < repeat_count; ++r)
+    {
+        for (auto& path: paths)
+        {
+            hash_xor ^= xiv::dat::PathHash(path).get_filename_hash();
+        }
+    }
+    std::cout << std::setw(16) << "PathHash" << ": " << std::fixed << std::setprecision(1)
+              << elapsed_seconds(start) * 1e9 / (repeat_count * path_count) << " ns/path (" << hash_xor << ")" << std::endl;
+}
+
+// Weapon model dirs of the chara index: full 10^8 buffer then a scan, against the streaming search
+void bench_search_hashes(xiv::dat::GameData& i_game_data)
+{
+    auto& index = i_game_data.get_category("chara").get_index();
+    std::string dir_format = "chara/weapon/w0000/obj/body/b0000/model";
+
+    auto start = bench_clock::now();
+    std::vector<uint32_t> hashes;
+    xiv::utils::crc32::generate_hashes_2(dir_format, 14, 29, hashes);
+    uint32_t buffer_found = 0;
+    for (auto hash: hashes)
+    {
+        if (index.check_dir_existence(hash))
+        {
+            ++buffer_found;
+        }
+    }
+    const double buffer_seconds = elapsed_seconds(start);
+    const std::size_t buffer_bytes = hashes.capacity() * sizeof(uint32_t);
+    std::vector<uint32_t>().swap(hashes);
+
+    start = bench_clock::now();
+    auto hits = index.search_dirs(dir_format, 14, 29);
+    const double search_seconds = elapsed_seconds(start);
+
+    if (hits.size() != buffer_found)
+    {
+        throw std::runtime_error("bench_search_hashes: hits do not match");
+    }
+
+    std::cout << "bench_search_hashes: " << hits.size() << " weapon dirs" << std::endl;
+    std::cout << "    buffer: " << buffer_bytes / (1024 * 1024) << " MB - " << std::fixed << std::setprecision(3) << buffer_seconds << " s" << std::endl;
+    std::cout << "    search: " << xiv::utils::crc32::search_chunk_size * sizeof(uint32_t) / 1024 << " KB per thread - " << search_seconds << " s" << std::endl;
+}
+
+// Hand-off of bursts of items to 2 * hardware consumers: polling with a 20 ms sleep as search_models did, against BoundedQueue
+// What matters is how long an item waits before a consumer picks it up
+void bench_work_queue()
+{
+    const uint32_t burst_count = 50;
+    const uint32_t burst_size = 64;
+    const uint32_t item_count = burst_count * burst_size;
+    const uint32_t consumer_count = 2 * std::max(1u, std::thread::hardware_concurrency());
+
+    // Some work per item, 64 KB of crc
+    std::vector<char> buffer(0x10000, 'x');
+    std::vector<bench_clock::time_point> push_times(item_count);
+    std::atomic<uint64_t> wait_nanoseconds(0);
+    std::atomic<uint32_t> crc(0);
+    auto consume = [&](uint32_t i_item) {
+        wait_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - push_times[i_item]).count();
+        crc ^= xiv::utils::crc32::update(i_item, buffer.data(), buffer.size());
+    };
+    // Bursts separated by idle times, like the dirs found by a search
+    auto produce = [&](const std::function<void(uint32_t)>& i_push) {
+        for (uint32_t b = 0; b < burst_count; ++b)
+        {
+            for (uint32_t i = b * burst_size; i < (b + 1) * burst_size; ++i)
+            {
+                push_times[i] = bench_clock::now();
+                i_push(i);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    };
+
+    auto start = bench_clock::now();
+    {
+        std::mutex queue_mutex;
+        std::queue<uint32_t> queue;
+        std::atomic<bool> work_done(false);
+        std::vector<std::thread> consumers;
+        for (uint32_t i = 0; i < consumer_count; ++i)
+        {
+            consumers.emplace_back([&] {
+                while (true)
+                {
+                    uint32_t item = 0;
+                    bool has_item = false;
+                    {
+                        std::lock_guard<std::mutex> lock(queue_mutex);
+                        if (!queue.empty())
+                        {
+                            item = queue.front();
+                            queue.pop();
+                            has_item = true;
+                        }
+                    }
+                    if (has_item)
+                    {
+                        consume(item);
+                    }
+                    else if (work_done)
+                    {
+                        break;
+                    }
+                    else
+                    {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                    }
+                }
+            });
+        }
+        produce([&](uint32_t i_item) {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            queue.push(i_item);
+        });
+        work_done = true;
+        for (auto& consumer: consumers)
+        {
+            consumer.join();
+        }
+    }
+    const double polling_seconds = elapsed_seconds(start);
+    const double polling_wait = wait_nanoseconds / 1e3 / item_count;
+    const uint32_t polling_crc = crc;
+
+    wait_nanoseconds = 0;
+    crc = 0;
+    start = bench_clock::now();
+    {
+        xiv::utils::work_queue::BoundedQueue<uint32_t> queue(4 * consumer_count);
+        xiv::utils::thread_pool::ThreadPool consumers(consumer_count);
+        for (uint32_t i = 0; i < consumer_count; ++i)
+        {
+            consumers.push([&] {
+                uint32_t item;
+                while (queue.pop(item))
+                {
+                    consume(item);
+                }
+            });
+        }
+        produce([&](uint32_t i_item) {
+            queue.push(i_item);
+        });
+        queue.close();
+    }
+    const double queue_seconds = elapsed_seconds(start);
+    const double queue_wait = wait_nanoseconds / 1e3 / item_count;
+
+    std::cout << "bench_work_queue: " << burst_count << " bursts of " << burst_size << " items - " << consumer_count << " consumers" << std::endl;
+    std::cout << "    polling: " << std::fixed << std::setprecision(3) << polling_seconds << " s - "
+              << std::setprecision(1) << polling_wait << " us wait/item" << std::endl;
+    std::cout << "      queue: " << std::setprecision(3) << queue_seconds << " s - "
+              << std::setprecision(1) << queue_wait << " us wait/item" << (polling_crc == crc ? "" : " - MISMATCH") << std::endl;
+}
+
+// SHA-1 kernels on a buffer, then the whole install checked by GameData::verify
+// The first number is the ceiling of a single block, the second what the parallel check over all the files gives
+void bench_verify(xiv::dat::GameData& i_game_data)
+{
+    std::mt19937 rng(0);
+    std::vector<char> buffer(0x4000000);
+    for (auto& c: buffer)
+    {
+        c = static_cast<char>(rng());
+    }
+
+    std::cout << "bench_verify: sha1 on 64MB" << std::endl;
+
+    const xiv::utils::sha1::Kernel kernels[] = { xiv::utils::sha1::Kernel::portable, xiv::utils::sha1::Kernel::sha_ni };
+    const char* names[] = { "portable", "sha_ni" };
+    xiv::utils::sha1::Digest reference_digest;
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        if (!xiv::utils::sha1::is_kernel_available(kernels[i]))
+        {
+            std::cout << std::setw(16) << names[i] << ": not available" << std::endl;
+            continue;
+        }
+
+        auto start = bench_clock::now();
+        auto digest = xiv::utils::sha1::compute(kernels[i], buffer.data(), buffer.size());
+        const double seconds = elapsed_seconds(start);
+
+        if (i == 0)
+        {
+            reference_digest = digest;
+        }
+        std::cout << std::setw(16) << names[i] << ": " << std::fixed << std::setprecision(2) << buffer.size() / seconds / 1e9 << " GB/s"
+                  << (digest == reference_digest ? "" : " - MISMATCH") << std::endl;
+    }
+
+    auto start = bench_clock::now();
+    auto verify_result = i_game_data.verify();
+    const double seconds = elapsed_seconds(start);
+
+    std::cout << std::setw(16) << "verify" << ": " << verify_result.file_count << " files - " << verify_result.block_count << " blocks - "
+              << std::setprecision(2) << verify_result.size / 1e9 << " GB in " << seconds << " s - "
+              << verify_result.size / seconds / 1e9 << " GB/s - " << verify_result.invalid_blocks.size() << " invalid" << std::endl;
+}
@@ -1,7 +1,7 @@
 #include <iostream>
 #include <thread>
-#include <mutex>
-#include <queue>
+#include <chrono>
+#include <algorithm>
 
 #include <boost/log/expressions.hpp>
 #include <boost/log/utility/setup/file.hpp>
@@ -11,16 +11,42 @@
 
 #include <xiv/utils/log.h>
 #include <xiv/utils/crc32.h>
+#include <xiv/utils/thread_pool.h>
+#include <xiv/utils/work_queue.h>
 
 #include <xiv/dat/GameData.h>
+#include <xiv/dat/PathPattern.h>
 #include <xiv/dat/File.h>
 #include <xiv/dat/Cat.h>
 #include <xiv/dat/Index.h>
+#include <xiv/dat/PathDictionary.h>
+
+#include <xiv/exd/ExdData.h>
+#include <xiv/exd/Cat.h>
+#include <xiv/exd/Exh.h>
+#include <xiv/exd/Exd.h>
 
 #include <xiv/mdl/Model.h>
+#include <xiv/mdl/Material.h>
+#include <xiv/tex/Texture.h>
 #include <xiv/mdl/logger.h>
 
-void search_models(xiv::dat::GameData& i_game_data);
+void search_models(xiv::dat::GameData& i_game_data, xiv::dat::PathDictionaryBuilder& io_path_builder);
+void collect_exd_paths(xiv::dat::GameData& i_game_data, xiv::dat::PathDictionaryBuilder& io_path_builder);
+void bench_dat_scaling(xiv::dat::GameData& i_game_data);
+void bench_parallel_decode(const boost::filesystem::path& i_path);
+void bench_decompress(xiv::dat::GameData& i_game_data);
+void bench_index(xiv::dat::GameData& i_game_data);
+void bench_index_cache(const boost::filesystem::path& i_path);
+void bench_get_files(xiv::dat::GameData& i_game_data);
+void bench_stream_file(xiv::dat::GameData& i_game_data);
+void bench_file_allocation(const boost::filesystem::path& i_path);
+void bench_open_categories(const boost::filesystem::path& i_path);
+void bench_path_hash(xiv::dat::GameData& i_game_data);
+void bench_crc32();
+void bench_search_hashes(xiv::dat::GameData& i_game_data);
+void bench_work_queue();
+void bench_verify(xiv::dat::GameData& i_game_data);
 
 int main(int argc, char* argv [])
 {
@@ -30,30 +56,96 @@ int main(int argc, char* argv [])
         xiv::utils::log::severity_level >= xiv::utils::log::Severity::trace
     );
 
-    auto game_data = xiv::dat::GameData("G:/SquareEnix/FINAL FANTASY XIV - A Realm Reborn/game/sqpack/ffxiv/");
+    const boost::filesystem::path game_data_path("G:/SquareEnix/FINAL FANTASY XIV - A Realm Reborn/game/sqpack/ffxiv/");
+    auto game_data = xiv::dat::GameData(game_data_path);
 
     if (false)
     {
         for (auto cat_nb : game_data.get_cat_nbs())
         {
             auto& cat = game_data.get_category(cat_nb);
-            for (auto& hash_table_entry : cat.get_index().get_hash_table())
+            for (auto& hash_table_entry : cat.get_index().get_entries())
             {
-                for (auto& dir_hash_table_entry : hash_table_entry.second)
-                {
-                    auto file = cat.get_file(hash_table_entry.first, dir_hash_table_entry.first);
+                auto file = cat.get_file(hash_table_entry.dir_hash, hash_table_entry.filename_hash);
 
-                    if (file->get_type() == xiv::dat::FileType::model)
-                    {
-                        //xiv::mdl::Model aModel(game_data, *file);
-                    }
+                if (file->get_type() == xiv::dat::FileType::model)
+                {
+                    //xiv::mdl::Model aModel(game_data, *file);
                 }
             }
         }
     }
+    else if (false)
+    {
+        bench_dat_scaling(game_data);
+        bench_parallel_decode(game_data_path);
+        bench_decompress(game_data);
+        bench_index(game_data);
+        bench_index_cache(game_data_path);
+        bench_get_files(game_data);
+        bench_stream_file(game_data);
+        bench_file_allocation(game_data_path);
+        bench_open_categories(game_data_path);
+        bench_path_hash(game_data);
+        bench_crc32();
+        bench_search_hashes(game_data);
+        bench_work_queue();
+        bench_verify(game_data);
+    }
+    else if (false)
+    {
+        // Whole install check, e.g. after patching
+        const auto start = std::chrono::steady_clock::now();
+        auto verify_result = game_data.verify();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (auto& invalid_block : verify_result.invalid_blocks)
+        {
+            std::cout << "Invalid block: " << invalid_block << std::endl;
+        }
+        std::cout << "Verified " << verify_result.file_count << " files - " << verify_result.block_count << " blocks - "
+                  << boost::format("%.2f GB in %.2f s - %.2f GB/s") % (verify_result.size / 1e9) % seconds % (verify_result.size / seconds / 1e9)
+                  << " - " << verify_result.invalid_blocks.size() << " invalid" << std::endl;
+    }
+    else if (false)
+    {
+        // Whole install dump, read in dat order instead of hash order
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t size = game_data.export_all("G:/projects/output_dump");
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << boost::format("Exported %.2f GB in %.2f s - %.1f MB/s") % (size / 1e9) % seconds % (size / seconds / 1e6) << std::endl;
+    }
+    else if (false)
+    {
+        // All the sheets as csv, loaded and written in parallel
+        const auto start = std::chrono::steady_clock::now();
+        xiv::exd::ExdData exd_data(game_data);
+        exd_data.export_as_csvs("G:/projects/output");
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << boost::format("Exported %d sheets in %.2f s") % exd_data.get_cat_names().size() % seconds << std::endl;
+    }
     else if (true)
     {
-        search_models(game_data);
+        // Known paths, extended by every discovery run
+        const boost::filesystem::path path_dictionary_path("G:/projects/paths.dict");
+
+        xiv::dat::PathDictionaryBuilder path_builder;
+        {
+            // Own GameData for the dictionary, its mapping must be released before the file is replaced
+            xiv::dat::Options options;
+            options.path_dictionary_path = path_dictionary_path;
+            xiv::dat::GameData discovery_game_data(game_data_path, options);
+            if (auto path_dictionary = discovery_game_data.get_path_dictionary())
+            {
+                path_builder.add(*path_dictionary);
+            }
+
+            search_models(discovery_game_data, path_builder);
+            collect_exd_paths(discovery_game_data, path_builder);
+        }
+        path_builder.write(path_dictionary_path);
     }
     else if (true)
     {
@@ -74,8 +166,7 @@ int main(int argc, char* argv [])
 
         for (auto& file_string : file_strings)
         {
-            auto file = game_data.get_file(file_string);
-            file->export_as_bin("G:/test.bin");
+            game_data.export_file_as_bin(file_string, "G:/test.bin");
         }
 
     }
@@ -83,269 +174,113 @@ int main(int argc, char* argv [])
     return 0;
 }
 
-void search_models(xiv::dat::GameData& i_game_data)
+void search_models(xiv::dat::GameData& i_game_data, xiv::dat::PathDictionaryBuilder& io_path_builder)
 {
-    auto& chara_cat = i_game_data.get_category("chara");
-    auto& cat_hash_table = chara_cat.get_index().get_hash_table();
+    // The search is cpu bound, the export threads spend a lot of time writing to disk so there are more of them
+    const uint32_t hardware_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t search_thread_count = hardware_thread_count;
+    const uint32_t export_thread_count = 2 * hardware_thread_count;
+    // Found models waiting for an export thread, the search blocks when they fall this far behind
+    const uint32_t models_queue_capacity = 4 * export_thread_count;
 
-    std::vector<std::thread> producer_thread_pool;
-    std::vector<std::thread> consumer_thread_pool;
-    std::mutex queue_mutex;
-    std::queue<std::string> models_queue;
+    xiv::utils::work_queue::BoundedQueue<std::string> models_queue(models_queue_capacity);
 
-    bool work_done = false;
-
-    // Creating consumers, 2 * hardware because these threads will spend a lot of time writing to disk
-    for (auto i = 0; i < 2 * std::thread::hardware_concurrency(); ++i)
+    xiv::utils::thread_pool::ThreadPool export_pool(export_thread_count);
+    for (uint32_t i = 0; i < export_thread_count; ++i)
     {
-        consumer_thread_pool.emplace_back([&] {
-            // Serve forever
-            while (true)
+        export_pool.push([&] {
+            // Serve until the queue is closed and drained
+            std::string model_path;
+            while (models_queue.pop(model_path))
             {
-                if (models_queue.empty())
+                try
                 {
-                    if (work_done)
-                    {
-                        break;
-                    }
-                    // Sleeps for 20 ms if nothing in the queue
-                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
-                }
-                else
-                {
-                    std::string model_path;
-                    {
-                        std::lock_guard<std::mutex> lock(queue_mutex);
-                        if (!models_queue.empty())
-                        {
-                            model_path = models_queue.front();
-                            models_queue.pop();
-                        }
-                    }
-                    if (!model_path.empty())
-                    {
-                        try
-                        {
-                            xiv::mdl::Model(i_game_data, model_path).export_as_json("G:/projects/output_mv");
-                        }
-                        catch (std::exception& e)
-                        {
-                            XIV_ERROR(xiv_mdl_logger, "ERROR on file: " << model_path << " - " << e.what());
-                        }
-                    }
-                }
-            }
-        });
-    }
-
-    // producer threads
-    producer_thread_pool.emplace_back([&] {
-        std::vector<uint32_t> crc_values;
-        std::string parts [] = { "face", "hair", "tail", "body" };
-        std::string suffixes [] = { "fac", "hir", "til", "top" };
-        std::string dir_str_format = "chara/human/c%04d/obj/%s/%s%04d/model";
-
-        for (uint32_t i = 0; i < 4; ++i)
-        {
-            std::string part_str_format_in = boost::str(boost::format(dir_str_format) % 0 % parts[i] % parts[i][0] % 0);
+                    xiv::mdl::Model model(i_game_data, model_path);
+                    model.export_as_json("G:/projects/output_mv");
 
-            xiv::utils::crc32::generate_hashes_2(part_str_format_in, 13, 28, crc_values);
-
-            for (uint32_t c = 0; c < 10000; ++c)
-            {
-                for (uint32_t p = 0; p < 10000; ++p)
-                {
-                    if (cat_hash_table.find(crc_values[c * 10000 + p]) != cat_hash_table.end())
+                    // The materials and textures it references are known paths as well
+                    for (auto& lod_materials : model.get_materials())
                     {
-                        std::string full_path = boost::str(boost::format(dir_str_format + "/c%04d%s%04d_%s.mdl") % c % parts[i] % parts[i][0] % p % c % parts[i][0] % p % suffixes[i]);
-
-                        if (i_game_data.check_file_existence(full_path))
+                        for (auto& material_entry : lod_materials)
                         {
-                            XIV_INFO(xiv_mdl_logger, "Found human: " << full_path);
-                            queue_mutex.lock();
-                            models_queue.push(full_path);
-                            queue_mutex.unlock();
+                            io_path_builder.add(material_entry.second.get_name());
+                            for (auto& texture : material_entry.second.get_texs())
+                            {
+                                io_path_builder.add(texture.get_name());
+                            }
                         }
                     }
                 }
-            }
-        }
-    });
-
-    producer_thread_pool.emplace_back([&] {
-        std::vector<uint32_t> dir_crc_values;
-        std::vector<uint32_t> file_crc_values;
-        std::string suffixes [] = { "met", "top", "glv", "dwn", "sho" };
-        std::string dir_str_format = "chara/equipment/e%04d/model";
-        std::string dir_str_format_in = boost::str(boost::format(dir_str_format) % 0);
-
-        xiv::utils::crc32::generate_hashes_1(dir_str_format_in, 17, dir_crc_values);
-
-        for (uint32_t e = 0; e < 10000; ++e)
-        {
-            auto cat_it = cat_hash_table.find(dir_crc_values[e]);
-            if (cat_it != cat_hash_table.end())
-            {
-                for (auto& suffix : suffixes)
+                catch (std::exception& e)
                 {
-                    std::string file_str_format = "c%04d" + boost::str(boost::format("e%04d_%s.mdl") % e % suffix);
-                    std::string file_str_format_in = boost::str(boost::format(file_str_format) % 0);
-
-                    xiv::utils::crc32::generate_hashes_1(file_str_format_in, 1, file_crc_values);
-
-                    for (uint32_t c = 0; c < 10000; ++c)
-                    {
-                        if (cat_it->second.find(file_crc_values[c]) != cat_it->second.end())
-                        {
-                            std::string full_path = boost::str(boost::format(dir_str_format + "/" + file_str_format) % e % c);
-
-                            XIV_INFO(xiv_mdl_logger, "Found equipment: " << full_path);
-                            queue_mutex.lock();
-                            models_queue.push(full_path);
-                            queue_mutex.unlock();
-                        }
-                    }
-                }
-            }
-        }
-    });
-
-    producer_thread_pool.emplace_back([&] {
-        std::vector<uint32_t> dir_crc_values;
-        std::vector<uint32_t> file_crc_values;
-        std::string suffixes [] = { "met", "top", "glv", "dwn", "sho" };
-        std::string dir_str_format = "chara/demihuman/d%04d/obj/equipment/e%04d/model";
-        std::string dir_str_format_in = boost::str(boost::format(dir_str_format) % 0 % 0);
-
-        xiv::utils::crc32::generate_hashes_2(dir_str_format_in, 17, 37, dir_crc_values);
-
-        for (uint32_t d = 0; d < 10000; ++d)
-        {
-            for (uint32_t e = 0; e < 10000; ++e)
-            {
-                auto cat_it = cat_hash_table.find(dir_crc_values[d * 10000 + e]);
-                if (cat_it != cat_hash_table.end())
-                {
-                    for (auto& suffix : suffixes)
-                    {
-                        std::string full_path = boost::str(boost::format(dir_str_format + "/d%04de%04d_%s.mdl") % d % e % d % e % suffix);
-
-                        if (i_game_data.check_file_existence(full_path))
-                        {
-                            XIV_INFO(xiv_mdl_logger, "Found demihuman: " << full_path);
-                            queue_mutex.lock();
-                            models_queue.push(full_path);
-                            queue_mutex.unlock();
-                        }
-                    }
-                }
-            }
-        }
-    });
-
-    producer_thread_pool.emplace_back([&] {
-        std::vector<uint32_t> dir_crc_values;
-        std::vector<uint32_t> file_crc_values;
-        std::string suffixes [] = { "ril", "rir", "wrs", "nek", "ear" };
-        std::string dir_str_format = "chara/accessory/a%04d/model";
-        std::string dir_str_format_in = boost::str(boost::format(dir_str_format) % 0);
-
-        xiv::utils::crc32::generate_hashes_1(dir_str_format_in, 17, dir_crc_values);
-
-        for (uint32_t a = 0; a < 10000; ++a)
-        {
-            auto cat_it = cat_hash_table.find(dir_crc_values[a]);
-            if (cat_it != cat_hash_table.end())
-            {
-                for (auto& suffix : suffixes)
-                {
-                    std::string file_str_format = "c%04d" + boost::str(boost::format("a%04d_%s.mdl") % a % suffix);
-                    std::string file_str_format_in = boost::str(boost::format(file_str_format) % 0);
-
-                    xiv::utils::crc32::generate_hashes_1(file_str_format_in, 1, file_crc_values);
-
-                    for (uint32_t c = 0; c < 10000; ++c)
-                    {
-                        if (cat_it->second.find(file_crc_values[c]) != cat_it->second.end())
-                        {
-                            std::string full_path = boost::str(boost::format(dir_str_format + "/" + file_str_format) % a % c);
-
-                            XIV_INFO(xiv_mdl_logger, "Found acessory: " << full_path);
-                            queue_mutex.lock();
-                            models_queue.push(full_path);
-                            queue_mutex.unlock();
-                        }
-                    }
+                    XIV_ERROR(xiv_mdl_logger, "ERROR on file: " << model_path << " - " << e.what());
                 }
             }
-        }
-    });
+        });
+    }
 
-    producer_thread_pool.emplace_back([&] {
-        std::vector<uint32_t> crc_values;
-        std::string dir_str_format = "chara/weapon/w%04d/obj/body/b%04d/model";
-        std::string dir_str_format_in = boost::str(boost::format(dir_str_format) % 0 % 0);
+    // Every model family as a pattern, all swept at once, the paths found go straight to the consumers
+    std::vector<xiv::dat::PathPattern> patterns = {
+        xiv::dat::PathPattern("chara/human/c{0000-9999}/obj/face/f{0000-9999}/model/c{1}f{2}_fac.mdl"),
+        xiv::dat::PathPattern("chara/human/c{0000-9999}/obj/hair/h{0000-9999}/model/c{1}h{2}_hir.mdl"),
+        xiv::dat::PathPattern("chara/human/c{0000-9999}/obj/tail/t{0000-9999}/model/c{1}t{2}_til.mdl"),
+        xiv::dat::PathPattern("chara/human/c{0000-9999}/obj/body/b{0000-9999}/model/c{1}b{2}_top.mdl"),
+        xiv::dat::PathPattern("chara/equipment/e{0000-9999}/model/c{0000-9999}e{1}_{met|top|glv|dwn|sho}.mdl"),
+        xiv::dat::PathPattern("chara/demihuman/d{0000-9999}/obj/equipment/e{0000-9999}/model/d{1}e{2}_{met|top|glv|dwn|sho}.mdl"),
+        xiv::dat::PathPattern("chara/accessory/a{0000-9999}/model/c{0000-9999}a{1}_{ril|rir|wrs|nek|ear}.mdl"),
+        xiv::dat::PathPattern("chara/weapon/w{0000-9999}/obj/body/b{0000-9999}/model/w{1}b{2}.mdl"),
+        xiv::dat::PathPattern("chara/monster/m{0000-9999}/obj/body/b{0000-9999}/model/m{1}b{2}.mdl")
+    };
+
+    xiv::utils::thread_pool::ThreadPool search_pool(search_thread_count);
+    try
+    {
+        i_game_data.search_paths(patterns, [&](const std::string& i_path) {
+            XIV_INFO(xiv_mdl_logger, "Found model: " << i_path);
+            io_path_builder.add(i_path);
+            models_queue.push(i_path);
+        }, &search_pool);
+    }
+    catch (...)
+    {
+        // Otherwise the export threads would wait forever and the pool could not be joined
+        models_queue.close();
+        throw;
+    }
 
-        xiv::utils::crc32::generate_hashes_2(dir_str_format_in, 14, 29, crc_values);
+    // The export threads finish the queue then stop, the pool joins them when it goes out of scope
+    models_queue.close();
+}
 
-        for (uint32_t w = 0; w < 10000; ++w)
+void collect_exd_paths(xiv::dat::GameData& i_game_data, xiv::dat::PathDictionaryBuilder& io_path_builder)
+{
+    // Some sheets hold paths as strings (sounds, maps, ...), every string is tried against the indexes
+    xiv::exd::ExdData exd_data(i_game_data);
+    uint32_t found_count = 0;
+    for (auto& cat_name : exd_data.get_cat_names())
+    {
+        auto& cat = exd_data.get_category(cat_name);
+        for (auto language : cat.get_languages())
         {
-            for (uint32_t b = 0; b < 10000; ++b)
+            // Only the string columns, scanned one after the other
+            auto& exd = cat.get_data_ln(language);
+            for (uint32_t field = 0; field < exd.get_field_count(); ++field)
             {
-                if (cat_hash_table.find(crc_values[w * 10000 + b]) != cat_hash_table.end())
+                if (exd.get_field_type(field) != xiv::exd::DataType::string)
                 {
-                    std::string full_path = boost::str(boost::format(dir_str_format + "/w%04db%04d.mdl") % w % b % w % b);
-
-                    if (i_game_data.check_file_existence(full_path))
-                    {
-                        XIV_INFO(xiv_mdl_logger, "Found weapon: " << full_path);
-                        queue_mutex.lock();
-                        models_queue.push(full_path);
-                        queue_mutex.unlock();
-                    }
+                    continue;
                 }
-            }
-        }
-    });
-
-    producer_thread_pool.emplace_back([&] {
-        std::vector<uint32_t> crc_values;
-        std::string dir_str_format = "chara/monster/m%04d/obj/body/b%04d/model";
-        std::string dir_str_format_in = boost::str(boost::format(dir_str_format) % 0 % 0);
-
-        xiv::utils::crc32::generate_hashes_2(dir_str_format_in, 15, 30, crc_values);
-
-        for (uint32_t m = 0; m < 10000; ++m)
-        {
-            for (uint32_t b = 0; b < 10000; ++b)
-            {
-                if (cat_hash_table.find(crc_values[m * 10000 + b]) != cat_hash_table.end())
+                for (uint32_t row = 0; row < exd.get_row_count(); ++row)
                 {
-                    std::string full_path = boost::str(boost::format(dir_str_format + "/m%04db%04d.mdl") % m % b % m % b);
-
-                    if (i_game_data.check_file_existence(full_path))
+                    if (io_path_builder.add_if_exists(i_game_data, exd.get_row_at(row).get_cstring(field)))
                     {
-                        XIV_INFO(xiv_mdl_logger, "Found monster: " << full_path);
-                        queue_mutex.lock();
-                        models_queue.push(full_path);
-                        queue_mutex.unlock();
+                        ++found_count;
                     }
                 }
             }
         }
-    });
-
-    for (auto& thread : producer_thread_pool)
-    {
-        thread.join();
-    }
-
-    work_done = true;
-
-    for (auto& thread : consumer_thread_pool)
-    {
-        thread.join();
     }
+    std::cout << "collect_exd_paths: " << found_count << " paths found in the exd strings" << std::endl;
 }
 
 
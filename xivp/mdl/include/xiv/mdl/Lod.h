@@ -44,8 +44,8 @@ public:
     Lod(const MdlLod& i_lod,
         const std::vector<MdlMesh>& i_meshes,
         const std::vector<std::vector<char>>& i_mesh_headers,
-        std::vector<char>& i_vertex_buffer_streams,
-        std::vector<char>& i_index_buffer);
+        std::vector<char> i_vertex_buffer_streams,
+        std::vector<char> i_index_buffer);
 
     ~Lod();
 
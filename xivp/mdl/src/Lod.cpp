@@ -29,8 +29,8 @@ namespace mdl
 Lod::Lod(const MdlLod& i_lod,
          const std::vector<MdlMesh>& i_meshes,
          const std::vector<std::vector<char>>& i_mesh_headers,
-         std::vector<char>& i_vertex_buffer_streams,
-         std::vector<char>& i_index_buffer) :
+         std::vector<char> i_vertex_buffer_streams,
+         std::vector<char> i_index_buffer) :
     _vertex_buffer_streams(std::move(i_vertex_buffer_streams)),
     _index_buffer(std::move(i_index_buffer))
 {
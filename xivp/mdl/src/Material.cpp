@@ -45,7 +45,8 @@ Material::Material(dat::GameData& i_game_data, const dat::File& i_file)
 
 void Material::initialize(dat::GameData& i_game_data, const dat::File& i_file)
 {
-    auto file_stream_ptr = utils::stream::get_istream(i_file.get_data_sections()[0]);
+    auto& data_section = i_file.get_data_sections()[0];
+    auto file_stream_ptr = utils::stream::get_istream(data_section.data(), data_section.size());
     auto& file_stream = *file_stream_ptr;
 
     MatHeader header = extract<xiv_mdl_logger, MatHeader>(file_stream);
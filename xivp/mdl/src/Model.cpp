@@ -111,7 +111,7 @@ void Model::initialize(dat::GameData& i_game_data, dat::File& i_file, const std:
     }
 
     auto& header_section = i_file.get_data_sections()[1];
-    auto header_stream_ptr = utils::stream::get_istream(header_section);
+    auto header_stream_ptr = utils::stream::get_istream(header_section.data(), header_section.size());
     auto& header_stream = *header_stream_ptr;
 
     uint32_t string_count = extract<xiv_mdl_logger, uint32_t>(header_stream, "string_count");
@@ -236,22 +236,17 @@ void Model::initialize(dat::GameData& i_game_data, dat::File& i_file, const std:
 
             std::string dir_str_format_in = boost::str(boost::format(dir_str_format) % 0);
 
-            std::vector<uint32_t> dir_crc_values;
-            xiv::utils::crc32::generate_hashes_1(dir_str_format_in, dir_str_format_in.size() - 4, dir_crc_values);
-
             auto& chara_cat = i_game_data.get_category("chara");
-            auto& cat_hash_table = chara_cat.get_index().get_hash_table();
+            auto& cat_index = chara_cat.get_index();
 
-            for (uint32_t v = 0; v < 10000; ++v)
+            for (auto& hit : cat_index.search_dirs(dir_str_format_in, dir_str_format_in.size() - 4))
             {
-                if (cat_hash_table.find(dir_crc_values[v]) != cat_hash_table.end())
+                const auto v = hit.first_value;
+                it = material_path.find_last_of("/");
+                std::string full_path = boost::str(boost::format(dir_str_format + material_path.substr(it)) % v);
+                if (i_game_data.check_file_existence(full_path))
                 {
-                    it = material_path.find_last_of("/");
-                    std::string full_path = boost::str(boost::format(dir_str_format + material_path.substr(it)) % v);
-                    if (i_game_data.check_file_existence(full_path))
-                    {
-                        material.emplace(v, Material(i_game_data, full_path));
-                    }
+                    material.emplace(v, Material(i_game_data, full_path));
                 }
             }
         }
@@ -275,7 +270,11 @@ void Model::initialize(dat::GameData& i_game_data, dat::File& i_file, const std:
     _lods.reserve(3);
     for (int i = 0; i < 3; ++i)
     {
-        _lods.emplace_back(Lod(lods[i], meshes, mesh_headers, i_file.access_data_sections()[2 + i], i_file.access_data_sections()[8 + i]));
+        auto& vertex_buffer_section = i_file.get_data_sections()[2 + i];
+        auto& index_buffer_section = i_file.get_data_sections()[8 + i];
+        _lods.emplace_back(Lod(lods[i], meshes, mesh_headers,
+                               std::vector<char>(vertex_buffer_section.begin(), vertex_buffer_section.end()),
+                               std::vector<char>(index_buffer_section.begin(), index_buffer_section.end())));
     }
 }
 
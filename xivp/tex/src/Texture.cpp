@@ -43,7 +43,7 @@ void Texture::initialize(std::unique_ptr<dat::File> i_file)
     }
 
     auto& header_section = i_file->get_data_sections()[0];
-    auto header_stream_ptr = utils::stream::get_istream(header_section);
+    auto header_stream_ptr = utils::stream::get_istream(header_section.data(), header_section.size());
 
     // Extract header
     TexHeader header = utils::bparse::extract<xiv_tex_logger, TexHeader>(*header_stream_ptr);